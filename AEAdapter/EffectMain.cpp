@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 
 #ifndef PF_WORLD_IS_FLOAT
   // Older SDKs don’t expose this macro. When unavailable, we won’t advertise float.
@@ -31,6 +32,11 @@
 template<typename T>
 static inline T clampT(T v, T lo, T hi) { return (v < lo) ? lo : (v > hi ? hi : v); }
 
+// Tensor Resolution popup → divisor (Full=1, Half=2, Quarter=4)
+static inline A_long TensorScaleFromPopup(A_long v) {
+    return v == KUWAHARA_TENSOR_RES_QUARTER ? 4 : (v == KUWAHARA_TENSOR_RES_HALF ? 2 : 1);
+}
+
 extern "C" char* GetStringPtr(int strNum);
 #define STR(x) GetStringPtr(x)
 
@@ -48,51 +54,30 @@ static PF_Err GlobalSetup(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef*
     out_data->my_version = PF_VERSION(1,0,0,0,0);
 
     // ★PiPL.r と完全一致させるため数値で固定（十進）
-    //   800 = 512(DEEP_COLOR_AWARE) + 256(PIX_INDEPENDENT) + 32(USE_OUTPUT_EXTENT)
+    //   804 = 512(DEEP_COLOR_AWARE) + 256(PIX_INDEPENDENT) + 32(USE_OUTPUT_EXTENT)
+    //       + 4(SEQUENCE_DATA_NEEDS_FLATTENING)
     //  1024 = SUPPORTS_SMART_RENDER
-    out_data->out_flags  = 800;
+    out_data->out_flags  = 804;
     out_data->out_flags2 = 1024;
 
-    // シーケンスデータ確保
     AEGP_SuiteHandler suites(in_data->pica_basicP);
-    out_data->sequence_data = suites.HandleSuite1()->host_new_handle(sizeof(KuwaharaSequenceData));
-    if (!out_data->sequence_data) {
-        return PF_Err_OUT_OF_MEMORY;
-    }
 
-    // 初期化
-    auto* seq = reinterpret_cast<KuwaharaSequenceData*>(
-        suites.HandleSuite1()->host_lock_handle(out_data->sequence_data));
-    if (seq) {
-        seq->version = 1;
-        seq->cached_width  = 0;
-        seq->cached_height = 0;
-        seq->cached_radius = -1;
-        seq->cached_anisotropy = -1.0;
-        seq->structure_tensor_data = nullptr;
-        seq->needs_recompute = TRUE;
-        suites.HandleSuite1()->host_unlock_handle(out_data->sequence_data);
+    // 永続テンソルキャッシュ（レンダーファーム向け、環境変数で有効化）
+    //   SALIS_KUWAHARA_TENSOR_CACHE_DIR : キャッシュディレクトリ（未設定なら無効）
+    //   SALIS_KUWAHARA_TENSOR_CACHE_MB  : 容量上限（既定 2048MB、超過分は古い順に削除）
+    if (const char* dir = std::getenv("SALIS_KUWAHARA_TENSOR_CACHE_DIR")) {
+        A_u_longlong mb = 2048;
+        if (const char* cap = std::getenv("SALIS_KUWAHARA_TENSOR_CACHE_MB")) mb = std::strtoull(cap, nullptr, 10);
+        ConfigureTensorDiskCache(dir, mb * 1024ull * 1024ull);
     }
-    
+
     // Status beacon for verification
     suites.ANSICallbacksSuite1()->sprintf(out_data->return_msg, "Salis Kuwahara v1.0 (%s %s)", __DATE__, __TIME__);
     
     return PF_Err_NONE;
 }
 
-static PF_Err GlobalSetdown(PF_InData* in_data, PF_OutData*, PF_ParamDef*[], PF_LayerDef*) {
-    AEGP_SuiteHandler suites(in_data->pica_basicP);
-    if (in_data->sequence_data) {
-        if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(
-                suites.HandleSuite1()->host_lock_handle(in_data->sequence_data))) {
-            if (seq->structure_tensor_data) {
-                DeleteStructureTensorField(seq->structure_tensor_data);
-                seq->structure_tensor_data = nullptr;
-            }
-            suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
-        }
-        suites.HandleSuite1()->host_dispose_handle(in_data->sequence_data);
-    }
+static PF_Err GlobalSetdown(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*) {
     return PF_Err_NONE;
 }
 
@@ -120,12 +105,109 @@ static PF_Err ParamsSetup(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef*
     PF_ADD_FLOAT_SLIDERX(STR(StrID_Mix_Param_Name),
         0, 100, 0, 100, 100, PF_Precision_TENTHS, 0, 0, MIX_DISK_ID);
 
+    // 大半径でもセクタあたりのタップ数を一定に保つモーメント・ミップマップ
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_CHECKBOXX(STR(StrID_AreaSampling_Param_Name), FALSE, 0, AREA_SAMPLING_DISK_ID);
+
+    // レンダー予算：0 = 全タップ。指定時は青色ノイズ的な部分集合でタップ数を制限
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX(STR(StrID_TapBudget_Param_Name),
+        0, 16384, 0, 2048, 0, PF_Precision_INTEGER, 0, 0, TAP_BUDGET_DISK_ID);
+
+    // 再生時に次フレームの構造テンソルをバックグラウンドで先読み
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_CHECKBOXX(STR(StrID_Prefetch_Param_Name), FALSE, 0, PREFETCH_DISK_ID);
+
+    // 内部で N 回のパスを実行（インスタンスの重ね掛けより往復とテンソル計算が少ない）
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_FLOAT_SLIDERX(STR(StrID_Iterations_Param_Name),
+        KUWAHARA_ITERATIONS_MIN, KUWAHARA_ITERATIONS_MAX, KUWAHARA_ITERATIONS_MIN, KUWAHARA_ITERATIONS_MAX,
+        KUWAHARA_ITERATIONS_DFLT, PF_Precision_INTEGER, 0, 0, ITERATIONS_DISK_ID);
+
+    // 構造テンソルの計算解像度（1/2・1/4 で計算し、参照時に双線形補間）
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_POPUPX(STR(StrID_TensorRes_Param_Name), KUWAHARA_TENSOR_RES_NUM, KUWAHARA_TENSOR_RES_FULL,
+        STR(StrID_TensorRes_Choices), 0, TENSOR_RES_DISK_ID);
+
+    // 入力をタイル配置にコピーし出力をブロック単位で処理（高異方性・大半径でキャッシュ効率が上がる。結果は同一）
+    AEFX_CLR_STRUCT(def);
+    PF_ADD_CHECKBOXX(STR(StrID_TiledSource_Param_Name), FALSE, 0, TILED_SOURCE_DISK_ID);
+
     out_data->num_params = KUWAHARA_NUM_PARAMS;
     return PF_Err_NONE;
 }
 
-static PF_Err SequenceSetup(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*)   { return PF_Err_NONE; }
-static PF_Err SequenceSetdown(PF_InData*, PF_OutData*, PF_ParamDef*[], PF_LayerDef*) { return PF_Err_NONE; }
+// ---- Sequence setup / setdown ------------------------------------------------
+// テンソル・先読みワーカー・作業バッファはインスタンス（シーケンス）ごとに保持する。
+// 生ポインタを含むので、保存・複製の前の FLATTEN で解放してから渡し、
+// RESETUP では受け取ったデータを引き継がずに作り直す（キャッシュのみなので失うものはない）
+static void InitSequenceData(KuwaharaSequenceData* seq) {
+    seq->version = 1;
+    seq->cached_width  = 0;
+    seq->cached_height = 0;
+    seq->cached_radius = -1;
+    seq->cached_anisotropy = -1.0;
+    seq->structure_tensor_data = nullptr;
+    seq->needs_recompute = TRUE;
+    AEFX_CLR_STRUCT(seq->last_stats);
+    seq->tensor_prefetch = nullptr;
+    seq->pass_scratch = nullptr;
+}
+
+static void ReleaseSequenceData(KuwaharaSequenceData* seq) {
+    if (seq->tensor_prefetch)       DeleteTensorPrefetcher(seq->tensor_prefetch);   // joins the worker
+    if (seq->structure_tensor_data) DeleteStructureTensorField(seq->structure_tensor_data);
+    if (seq->pass_scratch)          DeletePassScratch(seq->pass_scratch);
+    InitSequenceData(seq);
+}
+
+static PF_Err SequenceSetup(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef*[], PF_LayerDef*) {
+    AEGP_SuiteHandler suites(in_data->pica_basicP);
+    PF_Handle h = suites.HandleSuite1()->host_new_handle(sizeof(KuwaharaSequenceData));
+    if (!h) return PF_Err_OUT_OF_MEMORY;
+    if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(suites.HandleSuite1()->host_lock_handle(h))) {
+        InitSequenceData(seq);
+        suites.HandleSuite1()->host_unlock_handle(h);
+    }
+    out_data->sequence_data = h;
+    return PF_Err_NONE;
+}
+
+static PF_Err SequenceResetup(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef* params[], PF_LayerDef* output) {
+    // 受け取るのは FLATTEN 済み（ポインタなし）のデータ。複製元と共有しないよう新しく確保する
+    if (in_data->sequence_data) {
+        AEGP_SuiteHandler suites(in_data->pica_basicP);
+        suites.HandleSuite1()->host_dispose_handle(in_data->sequence_data);
+    }
+    return SequenceSetup(in_data, out_data, params, output);
+}
+
+static PF_Err SequenceFlatten(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef*[], PF_LayerDef*) {
+    if (in_data->sequence_data) {
+        AEGP_SuiteHandler suites(in_data->pica_basicP);
+        if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(
+                suites.HandleSuite1()->host_lock_handle(in_data->sequence_data))) {
+            ReleaseSequenceData(seq);
+            suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
+        }
+    }
+    out_data->sequence_data = in_data->sequence_data;
+    return PF_Err_NONE;
+}
+
+static PF_Err SequenceSetdown(PF_InData* in_data, PF_OutData* out_data, PF_ParamDef*[], PF_LayerDef*) {
+    if (in_data->sequence_data) {
+        AEGP_SuiteHandler suites(in_data->pica_basicP);
+        if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(
+                suites.HandleSuite1()->host_lock_handle(in_data->sequence_data))) {
+            ReleaseSequenceData(seq);
+            suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
+        }
+        suites.HandleSuite1()->host_dispose_handle(in_data->sequence_data);
+    }
+    out_data->sequence_data = nullptr;
+    return PF_Err_NONE;
+}
 
 // ---- Smart PreRender ---------------------------------------------------------
 static PF_Err PreRender(PF_InData* in_data, PF_OutData*, PF_PreRenderExtra* pre) {
@@ -146,6 +228,30 @@ static PF_Err PreRender(PF_InData* in_data, PF_OutData*, PF_PreRenderExtra* pre)
         pre->output->max_result_rect = in_res.max_result_rect;
         pre->output->flags = 0;
     }
+
+    // 先読み：次フレームの入力も要求しておく（投機的なので失敗は無視）
+    // ワーカーが未作成・滞留中なら要求しない（上流の次フレーム描画を前倒しさせない）
+    A_Boolean prefetch_room = FALSE;
+    if (!err && in_data->time_step > 0 && in_data->sequence_data) {
+        AEGP_SuiteHandler suites(in_data->pica_basicP);
+        if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(
+                suites.HandleSuite1()->host_lock_handle(in_data->sequence_data))) {
+            prefetch_room = TensorPrefetchHasRoom(seq->tensor_prefetch);
+            suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
+        }
+    }
+    if (prefetch_room) {
+        PF_ParamDef pfp; AEFX_CLR_STRUCT(pfp);
+        if (!PF_CHECKOUT_PARAM(in_data, KUWAHARA_PREFETCH, in_data->current_time, in_data->time_step, in_data->time_scale, &pfp)) {
+            if (pfp.u.bd.value) {
+                PF_CheckoutResult next_res;
+                (void)pre->cb->checkout_layer(in_data->effect_ref, KUWAHARA_INPUT, KUWAHARA_PREFETCH_CHECKOUT_ID,
+                                              &req, in_data->current_time + in_data->time_step,
+                                              in_data->time_step, in_data->time_scale, &next_res);
+            }
+            PF_CHECKIN_PARAM(in_data, &pfp);
+        }
+    }
     return err;
 }
 
@@ -161,13 +267,19 @@ static PF_Err SmartRender(PF_InData* in_data, PF_OutData*, PF_SmartRenderExtra*
     if (!err) err = sren->cb->checkout_output(in_data->effect_ref, &output);
     if (err || !input || !output) return err ? err : PF_Err_INTERNAL_STRUCT_DAMAGED;
 
-    PF_ParamDef rp, sp, ap, sop, mp;
-    AEFX_CLR_STRUCT(rp); AEFX_CLR_STRUCT(sp); AEFX_CLR_STRUCT(ap); AEFX_CLR_STRUCT(sop); AEFX_CLR_STRUCT(mp);
+    PF_ParamDef rp, sp, ap, sop, mp, asp, tbp, pfp, itp, trp, tlp;
+    AEFX_CLR_STRUCT(rp); AEFX_CLR_STRUCT(sp); AEFX_CLR_STRUCT(ap); AEFX_CLR_STRUCT(sop); AEFX_CLR_STRUCT(mp); AEFX_CLR_STRUCT(asp); AEFX_CLR_STRUCT(tbp); AEFX_CLR_STRUCT(pfp); AEFX_CLR_STRUCT(itp); AEFX_CLR_STRUCT(trp); AEFX_CLR_STRUCT(tlp);
     if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_RADIUS,     in_data->current_time, in_data->time_step, in_data->time_scale, &rp);
     if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_SECTORS,    in_data->current_time, in_data->time_step, in_data->time_scale, &sp);
     if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_ANISOTROPY, in_data->current_time, in_data->time_step, in_data->time_scale, &ap);
     if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_SOFTNESS,   in_data->current_time, in_data->time_step, in_data->time_scale, &sop);
     if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_MIX,        in_data->current_time, in_data->time_step, in_data->time_scale, &mp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_AREA_SAMPLING, in_data->current_time, in_data->time_step, in_data->time_scale, &asp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_TAP_BUDGET, in_data->current_time, in_data->time_step, in_data->time_scale, &tbp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_PREFETCH,   in_data->current_time, in_data->time_step, in_data->time_scale, &pfp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_ITERATIONS, in_data->current_time, in_data->time_step, in_data->time_scale, &itp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_TENSOR_RES, in_data->current_time, in_data->time_step, in_data->time_scale, &trp);
+    if (!err) err = PF_CHECKOUT_PARAM(in_data, KUWAHARA_TILED_SOURCE, in_data->current_time, in_data->time_step, in_data->time_scale, &tlp);
     if (err) { sren->cb->checkin_layer_pixels(in_data->effect_ref, KUWAHARA_INPUT); return err; }
 
     PF_FpLong radius     = rp.u.fs_d.value;
@@ -176,6 +288,16 @@ static PF_Err SmartRender(PF_InData* in_data, PF_OutData*, PF_SmartRenderExtra*
     PF_FpLong softness   = sop.u.fs_d.value / 100.0;
     PF_FpLong mix        = mp.u.fs_d.value / 100.0;
 
+    KuwaharaRenderOptions opts; AEFX_CLR_STRUCT(opts);
+    opts.area_sampling = asp.u.bd.value ? TRUE : FALSE;
+    opts.tap_budget    = (A_long)tbp.u.fs_d.value;
+    opts.iterations    = clampT<A_long>((A_long)itp.u.fs_d.value, KUWAHARA_ITERATIONS_MIN, KUWAHARA_ITERATIONS_MAX);
+    opts.tensor_scale  = TensorScaleFromPopup(trp.u.pd.value);
+    opts.tiled_source  = tlp.u.bd.value ? TRUE : FALSE;
+
+    KuwaharaRenderStats stats; AEFX_CLR_STRUCT(stats);
+    opts.stats = &stats;
+
     if (radius > 50) radius = 50 + (radius - 50) * 2;
     radius = clampT<PF_FpLong>(radius, 0.5, 400.0);
     sectors = clampT<A_long>(sectors, 3, 16);
@@ -201,24 +323,53 @@ static PF_Err SmartRender(PF_InData* in_data, PF_OutData*, PF_SmartRenderExtra*
                 seq->needs_recompute = TRUE;
             }
             if (!seq->structure_tensor_data) seq->structure_tensor_data = CreateStructureTensorField();
+            // 先読みワーカーはチェック中のみ保持（オフで解放し、コア側の毎フレームのハッシュも止める）
+            // 待機中の仕事はテンソルの入力（サイズ・深度・解像度）が変わったときワーカー側で破棄される
+            if (pfp.u.bd.value) {
+                if (!seq->tensor_prefetch) seq->tensor_prefetch = CreateTensorPrefetcher();
+            } else if (seq->tensor_prefetch) {
+                DeleteTensorPrefetcher(seq->tensor_prefetch);   // joins the worker
+                seq->tensor_prefetch = nullptr;
+            }
         }
     }
 
     if (PF_WORLD_IS_FLOAT(output)) {
-        err = ProcessKuwaharaWorld32fSmart(in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, seq);
+        err = ProcessKuwaharaWorld32fSmart(in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, &opts, seq);
     } else if (PF_WORLD_IS_DEEP(output)) {
-        err = ProcessKuwaharaWorld16Smart(in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, seq);
+        err = ProcessKuwaharaWorld16Smart(in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, &opts, seq);
     } else {
-        err = ProcessKuwaharaWorld8Smart (in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, seq);
+        err = ProcessKuwaharaWorld8Smart (in_data, input, output, (A_long)radius, sectors, anisotropy, softness, mix, &opts, seq);
     }
 
-    if (seq) suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
+    // 先読み：PreRender でチェックアウトした次フレームを投入（ここでは画素のコピーのみ、
+    // ハッシュ・輝度抽出・テンソル計算はワーカー側）
+    if (!err && seq && seq->tensor_prefetch && pfp.u.bd.value && in_data->time_step > 0) {
+        PF_EffectWorld* next = nullptr;
+        if (!sren->cb->checkout_layer_pixels(in_data->effect_ref, KUWAHARA_PREFETCH_CHECKOUT_ID, &next) && next) {
+            if      (PF_WORLD_IS_FLOAT(next)) PrefetchStructureTensor32f(seq->tensor_prefetch, next, opts.tensor_scale);
+            else if (PF_WORLD_IS_DEEP(next))  PrefetchStructureTensor16 (seq->tensor_prefetch, next, opts.tensor_scale);
+            else                              PrefetchStructureTensor8  (seq->tensor_prefetch, next, opts.tensor_scale);
+            sren->cb->checkin_layer_pixels(in_data->effect_ref, KUWAHARA_PREFETCH_CHECKOUT_ID);
+        }
+    }
+
+    if (seq) {
+        if (!err) seq->last_stats = stats;
+        suites.HandleSuite1()->host_unlock_handle(in_data->sequence_data);
+    }
 
     PF_CHECKIN_PARAM(in_data, &rp);
     PF_CHECKIN_PARAM(in_data, &sp);
     PF_CHECKIN_PARAM(in_data, &ap);
     PF_CHECKIN_PARAM(in_data, &sop);
     PF_CHECKIN_PARAM(in_data, &mp);
+    PF_CHECKIN_PARAM(in_data, &asp);
+    PF_CHECKIN_PARAM(in_data, &tbp);
+    PF_CHECKIN_PARAM(in_data, &pfp);
+    PF_CHECKIN_PARAM(in_data, &itp);
+    PF_CHECKIN_PARAM(in_data, &trp);
+    PF_CHECKIN_PARAM(in_data, &tlp);
     sren->cb->checkin_layer_pixels(in_data->effect_ref, KUWAHARA_INPUT);
     return err;
 }
@@ -231,16 +382,23 @@ static PF_Err Render(PF_InData* in_data, PF_OutData*, PF_ParamDef* params[], PF_
     PF_FpLong softness   = params[KUWAHARA_SOFTNESS]->u.fs_d.value   / 100.0;
     PF_FpLong mix        = params[KUWAHARA_MIX]->u.fs_d.value        / 100.0;
 
+    KuwaharaRenderOptions opts; AEFX_CLR_STRUCT(opts);
+    opts.area_sampling = params[KUWAHARA_AREA_SAMPLING]->u.bd.value ? TRUE : FALSE;
+    opts.tap_budget    = (A_long)params[KUWAHARA_TAP_BUDGET]->u.fs_d.value;
+    opts.iterations    = clampT<A_long>((A_long)params[KUWAHARA_ITERATIONS]->u.fs_d.value, KUWAHARA_ITERATIONS_MIN, KUWAHARA_ITERATIONS_MAX);
+    opts.tensor_scale  = TensorScaleFromPopup(params[KUWAHARA_TENSOR_RES]->u.pd.value);
+    opts.tiled_source  = params[KUWAHARA_TILED_SOURCE]->u.bd.value ? TRUE : FALSE;
+
     if (radius > 50) radius = 50 + (radius - 50) * 2;
     radius = clampT<PF_FpLong>(radius, 0.5, 400.0);
     sectors = clampT<A_long>(sectors, 3, 16);
 
     if (PF_WORLD_IS_DEEP(output)) {
         return ProcessKuwaharaWorld16(in_data, &params[KUWAHARA_INPUT]->u.ld, output,
-                                      (A_long)radius, sectors, anisotropy, softness, mix);
+                                      (A_long)radius, sectors, anisotropy, softness, mix, &opts);
     } else {
         return ProcessKuwaharaWorld8 (in_data, &params[KUWAHARA_INPUT]->u.ld, output,
-                                      (A_long)radius, sectors, anisotropy, softness, mix);
+                                      (A_long)radius, sectors, anisotropy, softness, mix, &opts);
     }
 }
 
@@ -274,6 +432,8 @@ PF_Err EffectMain(PF_Cmd cmd, PF_InData* in_data, PF_OutData* out_data, PF_Param
         case PF_Cmd_GLOBAL_SETDOWN:    err = GlobalSetdown(in_data, out_data, params, output); break;
         case PF_Cmd_PARAMS_SETUP:      err = ParamsSetup(in_data, out_data, params, output); break;
         case PF_Cmd_SEQUENCE_SETUP:    err = SequenceSetup(in_data, out_data, params, output); break;
+        case PF_Cmd_SEQUENCE_RESETUP:  err = SequenceResetup(in_data, out_data, params, output); break;
+        case PF_Cmd_SEQUENCE_FLATTEN:  err = SequenceFlatten(in_data, out_data, params, output); break;
         case PF_Cmd_SEQUENCE_SETDOWN:  err = SequenceSetdown(in_data, out_data, params, output); break;
         case PF_Cmd_SMART_PRE_RENDER:  err = PreRender(in_data, out_data, reinterpret_cast<PF_PreRenderExtra*>(extra)); break;
         case PF_Cmd_SMART_RENDER:      err = SmartRender(in_data, out_data, reinterpret_cast<PF_SmartRenderExtra*>(extra)); break;
@@ -19,8 +19,9 @@ resource 'PiPL' (16000)
     CodeWin64X86         { "EffectMain" },
 #endif
 
-    /* OutFlags = 512 (DEEP_COLOR_AWARE) + 256 (PIX_INDEPENDENT) + 32 (USE_OUTPUT_EXTENT) = 800 */
-    AE_Effect_Global_OutFlags   { 800 },
+    /* OutFlags = 512 (DEEP_COLOR_AWARE) + 256 (PIX_INDEPENDENT) + 32 (USE_OUTPUT_EXTENT)
+                + 4 (SEQUENCE_DATA_NEEDS_FLATTENING) = 804 */
+    AE_Effect_Global_OutFlags   { 804 },
 
     /* OutFlags2 = 1024 (SUPPORTS_SMART_RENDER のみ。Float-aware は未広告) */
     AE_Effect_Global_OutFlags_2 { 1024 },
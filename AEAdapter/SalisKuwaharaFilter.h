@@ -76,6 +76,16 @@ typedef short int			int16;
 #define	KUWAHARA_SOFTNESS_MAX		1.0
 #define	KUWAHARA_SOFTNESS_DFLT		0.0
 
+#define	KUWAHARA_ITERATIONS_MIN		1	/* KUWAHARA_ITERATIONS_MAX is in API.h (shared with the core) */
+#define	KUWAHARA_ITERATIONS_DFLT	1
+
+enum {	/* Tensor Resolution popup (1-based) */
+	KUWAHARA_TENSOR_RES_FULL = 1,
+	KUWAHARA_TENSOR_RES_HALF,
+	KUWAHARA_TENSOR_RES_QUARTER,
+	KUWAHARA_TENSOR_RES_NUM = KUWAHARA_TENSOR_RES_QUARTER
+};
+
 enum {
 	KUWAHARA_INPUT = 0,
 	KUWAHARA_RADIUS,
@@ -83,6 +93,12 @@ enum {
 	KUWAHARA_ANISOTROPY,
 	KUWAHARA_SOFTNESS,
 	KUWAHARA_MIX,
+	KUWAHARA_AREA_SAMPLING,
+	KUWAHARA_TAP_BUDGET,
+	KUWAHARA_PREFETCH,
+	KUWAHARA_ITERATIONS,
+	KUWAHARA_TENSOR_RES,
+	KUWAHARA_TILED_SOURCE,
 	KUWAHARA_NUM_PARAMS
 };
 
@@ -92,8 +108,18 @@ enum {
 	ANISOTROPY_DISK_ID,
 	SOFTNESS_DISK_ID,
 	MIX_DISK_ID,
+	AREA_SAMPLING_DISK_ID,
+	TAP_BUDGET_DISK_ID,
+	PREFETCH_DISK_ID,
+	ITERATIONS_DISK_ID,
+	TENSOR_RES_DISK_ID,
+	TILED_SOURCE_DISK_ID,
 };
 
+/* Smart-render checkout ids (input layer uses KUWAHARA_INPUT) */
+
+#define	KUWAHARA_PREFETCH_CHECKOUT_ID	1	// input at current_time + time_step
+
 typedef struct KuwaharaInfo {
 	PF_FpLong	radius;
 	A_long		sectorCount;
@@ -108,10 +134,10 @@ typedef struct KuwaharaInfo {
 } KuwaharaInfo, *KuwaharaInfoP, **KuwaharaInfoH;
 
 #ifndef DllExport
-#  if defined(__APPLE__)
-#    define DllExport __attribute__((visibility("default")))
-#  else
+#  if defined(_WIN32)
 #    define DllExport __declspec(dllexport)
+#  else
+#    define DllExport __attribute__((visibility("default")))
 #  endif
 #endif
 
@@ -20,6 +20,13 @@ TableString	g_strs[StrID_NUMTYPES] = {
 	StrID_Anisotropy_Param_Name,	"Anisotropy",
 	StrID_Softness_Param_Name,		"Softness",
 	StrID_Mix_Param_Name,			"Mix",
+	StrID_AreaSampling_Param_Name,	"Area Sampling (Mip)",
+	StrID_TapBudget_Param_Name,		"Tap Budget (per px)",
+	StrID_Prefetch_Param_Name,		"Prefetch Next Frame",
+	StrID_Iterations_Param_Name,		"Iterations",
+	StrID_TensorRes_Param_Name,		"Tensor Resolution",
+	StrID_TensorRes_Choices,		"Full|Half|Quarter",
+	StrID_TiledSource_Param_Name,	"Tiled Source Layout",
 };
 
 char *GetStringPtr(int strNum)
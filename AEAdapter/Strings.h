@@ -15,5 +15,12 @@ typedef enum {
 	StrID_Anisotropy_Param_Name,
 	StrID_Softness_Param_Name,
 	StrID_Mix_Param_Name,
+	StrID_AreaSampling_Param_Name,
+	StrID_TapBudget_Param_Name,
+	StrID_Prefetch_Param_Name,
+	StrID_Iterations_Param_Name,
+	StrID_TensorRes_Param_Name,
+	StrID_TensorRes_Choices,
+	StrID_TiledSource_Param_Name,
 	StrID_NUMTYPES
 } StrIDType;
\ No newline at end of file
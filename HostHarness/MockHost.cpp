@@ -0,0 +1,556 @@
+/*******************************************************************/
+/* Salis Kuwahara Filter — mock AE host (profiling harness)        */
+/*******************************************************************/
+// Drives EffectMain without After Effects:
+//   GLOBAL_SETUP → PARAMS_SETUP → SEQUENCE_SETUP →
+//   (SMART_PRE_RENDER → SMART_RENDER) × frames → SEQUENCE_SETDOWN → GLOBAL_SETDOWN
+// over synthetic frames, and reports per-command latency, where each frame's
+// structure tensor came from, and handle / checkout balance.
+// Only the callbacks EffectMain actually uses are implemented; anything else
+// is left null so a new dependency shows up as a crash here, not in AE.
+// Not part of the plugin target — see build_mock_host.sh.
+#include "SalisKuwaharaFilter.h"
+#include "API.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// ---- Options ----------------------------------------------------------------
+struct ParamArg { const char* flag; PF_ParamIndex index; };
+static const ParamArg kParamArgs[] = {
+    { "--radius",      KUWAHARA_RADIUS },
+    { "--sectors",     KUWAHARA_SECTORS },
+    { "--anisotropy",  KUWAHARA_ANISOTROPY },
+    { "--softness",    KUWAHARA_SOFTNESS },
+    { "--mix",         KUWAHARA_MIX },
+    { "--area",        KUWAHARA_AREA_SAMPLING },
+    { "--budget",      KUWAHARA_TAP_BUDGET },
+    { "--prefetch",    KUWAHARA_PREFETCH },
+    { "--iterations",  KUWAHARA_ITERATIONS },
+    { "--tensor-res",  KUWAHARA_TENSOR_RES },
+    { "--tiled",       KUWAHARA_TILED_SOURCE },
+};
+
+struct Options {
+    A_long width = 1920, height = 1080;
+    A_long depth = 8;              // 8 or 16
+    A_long frames = 24;
+    A_long hold = 1;               // frames per distinct content (0 = one still)
+    A_long tweak_every = 0;        // bump Radius every N frames (0 = never)
+    A_long pace_ms = 0;            // idle time between frames (lets prefetch run)
+    const char* tensor_cache = nullptr;
+    bool csv = false;
+    std::vector<std::pair<PF_ParamIndex, PF_FpLong>> params;
+};
+
+static void Usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--size WxH] [--depth 8|16] [--frames N] [--hold N] [--tweak-every N]\n"
+        "          [--pace MS] [--tensor-cache DIR] [--csv]\n"
+        "          [--radius V] [--sectors V] [--anisotropy V] [--softness V] [--mix V]\n"
+        "          [--area 0|1] [--budget V] [--prefetch 0|1] [--iterations V] [--tensor-res 1|2|3]\n"
+        "          [--tiled 0|1]\n",
+        argv0);
+}
+
+static bool ParseArgs(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (a == "--csv") { o.csv = true; continue; }
+        if (!v) return false;
+        ++i;
+        if      (a == "--size")         { if (std::sscanf(v, "%dx%d", &o.width, &o.height) != 2) return false; }
+        else if (a == "--depth")        { o.depth = std::atoi(v); }
+        else if (a == "--frames")       { o.frames = std::atoi(v); }
+        else if (a == "--hold")         { o.hold = std::atoi(v); }
+        else if (a == "--tweak-every")  { o.tweak_every = std::atoi(v); }
+        else if (a == "--pace")         { o.pace_ms = std::atoi(v); }
+        else if (a == "--tensor-cache") { o.tensor_cache = v; }
+        else {
+            bool known = false;
+            for (const ParamArg& p : kParamArgs) {
+                if (a == p.flag) { o.params.emplace_back(p.index, std::atof(v)); known = true; break; }
+            }
+            if (!known) return false;
+        }
+    }
+    return o.width > 0 && o.height > 0 && (o.depth == 8 || o.depth == 16) && o.frames > 0;
+}
+
+// ---- Latency bookkeeping ----------------------------------------------------
+struct Latency {
+    A_long count = 0;
+    double total = 0.0, min = 0.0, max = 0.0, last = 0.0;   // ms
+    void add(double ms) {
+        last = ms;
+        min = count ? std::min(min, ms) : ms;
+        max = count ? std::max(max, ms) : ms;
+        total += ms; ++count;
+    }
+};
+
+static const char* CmdName(PF_Cmd cmd) {
+    switch (cmd) {
+    case PF_Cmd_GLOBAL_SETUP:      return "GLOBAL_SETUP";
+    case PF_Cmd_GLOBAL_SETDOWN:    return "GLOBAL_SETDOWN";
+    case PF_Cmd_PARAMS_SETUP:      return "PARAMS_SETUP";
+    case PF_Cmd_SEQUENCE_SETUP:    return "SEQUENCE_SETUP";
+    case PF_Cmd_SEQUENCE_RESETUP:  return "SEQUENCE_RESETUP";
+    case PF_Cmd_SEQUENCE_FLATTEN:  return "SEQUENCE_FLATTEN";
+    case PF_Cmd_SEQUENCE_SETDOWN:  return "SEQUENCE_SETDOWN";
+    case PF_Cmd_UPDATE_PARAMS_UI:  return "UPDATE_PARAMS_UI";
+    case PF_Cmd_SMART_PRE_RENDER:  return "SMART_PRE_RENDER";
+    case PF_Cmd_SMART_RENDER:      return "SMART_RENDER";
+    default:                       return "?";
+    }
+}
+
+static const char* TensorSourceName(A_long s) {
+    switch (s) {
+    case KUWAHARA_TENSOR_SOURCE_REUSED:   return "reused";
+    case KUWAHARA_TENSOR_SOURCE_COMPUTED: return "computed";
+    case KUWAHARA_TENSOR_SOURCE_PREFETCH: return "prefetch";
+    case KUWAHARA_TENSOR_SOURCE_DISK:     return "disk";
+    default:                              return "?";
+    }
+}
+
+// ---- Worlds -----------------------------------------------------------------
+struct MockWorld {
+    PF_EffectWorld     world;
+    std::vector<char>  pixels;
+
+    MockWorld(A_long w, A_long h, A_long depth, bool writeable) {
+        const A_long pixelBytes = depth == 16 ? (A_long)sizeof(PF_Pixel16) : (A_long)sizeof(PF_Pixel8);
+        const A_long rowbytes = ((w * pixelBytes) + 15) & ~15;   // hosts pad rows; the core must honour rowbytes
+        pixels.assign((size_t)rowbytes * (size_t)h, 0);
+        std::memset(&world, 0, sizeof(world));
+        world.world_flags = (depth == 16 ? PF_WorldFlag_DEEP : 0) | (writeable ? PF_WorldFlag_WRITEABLE : 0);
+        world.data        = reinterpret_cast<PF_PixelPtr>(pixels.data());
+        world.rowbytes    = rowbytes;
+        world.width       = w;
+        world.height      = h;
+        world.extent_hint.left = 0; world.extent_hint.top = 0;
+        world.extent_hint.right = w; world.extent_hint.bottom = h;
+    }
+};
+
+// Deterministic test card per content id: a slow gradient, oriented stripes
+// whose angle varies across the frame (exercises the tensor), and mild noise.
+static void FillSynthetic(MockWorld& mw, A_long depth, A_long content) {
+    const PF_EffectWorld& w = mw.world;
+    const float phase = 0.15f * (float)content;
+    for (A_long y = 0; y < w.height; ++y) {
+        char* row = mw.pixels.data() + (size_t)y * (size_t)w.rowbytes;
+        for (A_long x = 0; x < w.width; ++x) {
+            const float u = (float)x / (float)std::max<A_long>(1, w.width - 1);
+            const float v = (float)y / (float)std::max<A_long>(1, w.height - 1);
+            const float ang = 3.14159265f * (u + 0.5f * v) + phase;
+            const float s = 0.5f + 0.5f * std::sin(0.12f * ((float)x * std::cos(ang) + (float)y * std::sin(ang)));
+            std::uint32_t hsh = (std::uint32_t)x * 73856093u ^ (std::uint32_t)y * 19349663u ^ (std::uint32_t)content * 83492791u;
+            hsh ^= hsh >> 13; hsh *= 0x5bd1e995u; hsh ^= hsh >> 15;
+            const float n = ((float)(hsh & 0xFF) / 255.0f - 0.5f) * 0.08f;
+            const float r = std::min(1.f, std::max(0.f, 0.6f * s + 0.4f * u + n));
+            const float g = std::min(1.f, std::max(0.f, 0.6f * s + 0.4f * v + n));
+            const float b = std::min(1.f, std::max(0.f, 0.5f * (1.f - s) + 0.3f + n));
+            if (depth == 16) {
+                PF_Pixel16& p = reinterpret_cast<PF_Pixel16*>(row)[x];
+                p.alpha = 32768;
+                p.red   = (A_u_short)(r * 32768.f + 0.5f);
+                p.green = (A_u_short)(g * 32768.f + 0.5f);
+                p.blue  = (A_u_short)(b * 32768.f + 0.5f);
+            } else {
+                PF_Pixel8& p = reinterpret_cast<PF_Pixel8*>(row)[x];
+                p.alpha = 255;
+                p.red   = (A_u_char)(r * 255.f + 0.5f);
+                p.green = (A_u_char)(g * 255.f + 0.5f);
+                p.blue  = (A_u_char)(b * 255.f + 0.5f);
+            }
+        }
+    }
+}
+
+// ---- Host -------------------------------------------------------------------
+struct MockHandle {
+    void*        ptr;          // must stay first: PF_Handle points here
+    A_HandleSize size;
+    A_long       locks;
+};
+
+struct MockHost {
+    Options                  opt;
+    PF_InData                in_data;
+    PF_OutData               out_data;
+    SPBasicSuite             basic;
+    PF_HandleSuite1          handle_suite;
+    PF_ANSICallbacksSuite1   ansi_suite;
+    PF_PreRenderCallbacks    pre_cb;
+    PF_SmartRenderCallbacks  smart_cb;
+
+    std::vector<PF_ParamDef> params;                  // [0] = input layer
+    std::set<MockHandle*>    handles;
+    std::map<A_long, A_long> layer_requests;          // checkout id → time
+    std::map<A_long, std::unique_ptr<MockWorld>> frames;   // content id → pixels (current and next only)
+    std::unique_ptr<MockWorld> output;
+    std::map<PF_Cmd, Latency> latency;
+    std::set<std::string>    missing_suites;
+
+    A_long handles_created = 0, handles_disposed = 0;
+    A_long params_out = 0, layers_out = 0;
+    A_long late_fills = 0;                            // frames generated inside a timed call
+    double fill_ms = 0.0;                             // generation time, kept out of "wall"
+};
+
+static MockHost* g_host = nullptr;
+
+// Handle suite
+static PF_Handle MockNewHandle(A_HandleSize size) {
+    MockHandle* h = new MockHandle;
+    h->ptr = std::calloc(1, (size_t)std::max<A_HandleSize>(size, 1));
+    h->size = size; h->locks = 0;
+    g_host->handles.insert(h); ++g_host->handles_created;
+    return reinterpret_cast<PF_Handle>(&h->ptr);
+}
+static MockHandle* FromHandle(PF_Handle ph) {
+    MockHandle* h = reinterpret_cast<MockHandle*>(ph);
+    return (h && g_host->handles.count(h)) ? h : nullptr;
+}
+static void* MockLockHandle(PF_Handle ph)   { MockHandle* h = FromHandle(ph); if (!h) return nullptr; ++h->locks; return h->ptr; }
+static void  MockUnlockHandle(PF_Handle ph) { if (MockHandle* h = FromHandle(ph)) --h->locks; }
+static void  MockDisposeHandle(PF_Handle ph) {
+    MockHandle* h = FromHandle(ph);
+    if (!h) return;
+    if (h->locks != 0) std::fprintf(stderr, "warning: handle disposed with lock count %d\n", h->locks);
+    g_host->handles.erase(h); ++g_host->handles_disposed;
+    std::free(h->ptr); delete h;
+}
+static A_HandleSize MockGetHandleSize(PF_Handle ph) { MockHandle* h = FromHandle(ph); return h ? h->size : 0; }
+static PF_Err MockResizeHandle(A_HandleSize size, PF_Handle* pph) {
+    MockHandle* h = pph ? FromHandle(*pph) : nullptr;
+    if (!h) return PF_Err_BAD_CALLBACK_PARAM;
+    void* p = std::realloc(h->ptr, (size_t)std::max<A_HandleSize>(size, 1));
+    if (!p) return PF_Err_OUT_OF_MEMORY;
+    if (size > h->size) std::memset(static_cast<char*>(p) + h->size, 0, (size_t)(size - h->size));
+    h->ptr = p; h->size = size;
+    return PF_Err_NONE;
+}
+
+// ANSI suite (EffectMain only uses sprintf; the rest forward to libm)
+static int MockSprintf(A_char* buf, const A_char* fmt, ...) {
+    va_list ap; va_start(ap, fmt);
+    const int n = std::vsnprintf(buf, PF_MAX_EFFECT_MSG_LEN + 1, fmt, ap);
+    va_end(ap);
+    return n;
+}
+static A_char* MockStrcpy(A_char* d, const A_char* s) { return std::strcpy(d, s); }
+
+// SPBasic
+static const SPErr kMockSuiteNotFound = 0x53214664;   // 'S!Fd', same as kSPSuiteNotFoundError
+static SPErr MockAcquireSuite(const char* name, int32 version, const void** suite) {
+    if (!std::strcmp(name, kPFHandleSuite) && version == kPFHandleSuiteVersion1) { *suite = &g_host->handle_suite; return 0; }
+    if (!std::strcmp(name, kPFANSISuite)   && version == kPFANSISuiteVersion1)   { *suite = &g_host->ansi_suite;   return 0; }
+    g_host->missing_suites.insert(std::string(name) + " v" + std::to_string(version));
+    *suite = nullptr;
+    return kMockSuiteNotFound;
+}
+static SPErr     MockReleaseSuite(const char*, int32) { return 0; }
+static SPBoolean MockIsEqual(const char* a, const char* b) { return std::strcmp(a, b) == 0; }
+static SPErr     MockAllocateBlock(size_t n, void** p) { *p = std::malloc(n); return *p ? 0 : kMockSuiteNotFound; }
+static SPErr     MockFreeBlock(void* p) { std::free(p); return 0; }
+static SPErr     MockReallocateBlock(void* p, size_t n, void** q) { *q = std::realloc(p, n); return *q ? 0 : kMockSuiteNotFound; }
+static SPErr     MockUndefined() { return kMockSuiteNotFound; }
+
+// Interact callbacks
+static PF_Err MockAddParam(PF_ProgPtr, PF_ParamIndex index, PF_ParamDefPtr def) {
+    if (!def) return PF_Err_BAD_CALLBACK_PARAM;
+    if (index < 0 || index >= (PF_ParamIndex)g_host->params.size()) g_host->params.push_back(*def);
+    else g_host->params[index] = *def;
+    return PF_Err_NONE;
+}
+static PF_Err MockCheckoutParam(PF_ProgPtr, PF_ParamIndex index, A_long, A_long, A_u_long, PF_ParamDef* param) {
+    if (!param || index < 0 || index >= (PF_ParamIndex)g_host->params.size()) return PF_Err_BAD_CALLBACK_PARAM;
+    *param = g_host->params[index];
+    ++g_host->params_out;
+    return PF_Err_NONE;
+}
+static PF_Err MockCheckinParam(PF_ProgPtr, PF_ParamDef*) { --g_host->params_out; return PF_Err_NONE; }
+
+// Smart callbacks
+static A_long ContentId(A_long time) {
+    const A_long hold = g_host->opt.hold;
+    return hold > 0 ? time / hold : 0;
+}
+static PF_Err MockCheckoutLayer(PF_ProgPtr, PF_ParamIndex index, A_long checkout_id, const PF_RenderRequest*,
+                                A_long what_time, A_long, A_u_long, PF_CheckoutResult* result) {
+    if (index != KUWAHARA_INPUT || !result) return PF_Err_BAD_CALLBACK_PARAM;
+    g_host->layer_requests[checkout_id] = what_time;
+    std::memset(result, 0, sizeof(*result));
+    result->result_rect.right  = result->max_result_rect.right  = g_host->opt.width;
+    result->result_rect.bottom = result->max_result_rect.bottom = g_host->opt.height;
+    result->ref_width = g_host->opt.width; result->ref_height = g_host->opt.height;
+    return PF_Err_NONE;
+}
+static PF_Err MockCheckoutLayerPixels(PF_ProgPtr, A_long checkout_id, PF_EffectWorld** pixels) {
+    auto req = g_host->layer_requests.find(checkout_id);
+    if (req == g_host->layer_requests.end() || !pixels) return PF_Err_BAD_CALLBACK_PARAM;   // not requested in PreRender
+    const A_long content = ContentId(req->second);
+    std::unique_ptr<MockWorld>& mw = g_host->frames[content];
+    if (!mw) {   // PrepareFrames should have made it; this lands in the render timing
+        mw.reset(new MockWorld(g_host->opt.width, g_host->opt.height, g_host->opt.depth, false));
+        FillSynthetic(*mw, g_host->opt.depth, content);
+        ++g_host->late_fills;
+    }
+    *pixels = &mw->world;
+    ++g_host->layers_out;
+    return PF_Err_NONE;
+}
+// Generates the content for `time` and the next frame (the prefetch checkout)
+// before the timed commands run, and drops everything older, so synthetic
+// generation is neither counted as render latency nor kept for the whole run.
+static void PrepareFrames(MockHost& h, A_long time) {
+    const Clock::time_point t0 = Clock::now();
+    const A_long first = ContentId(time);
+    h.frames.erase(h.frames.begin(), h.frames.lower_bound(first));
+    for (A_long t = time; t <= time + 1; ++t) {
+        const A_long content = ContentId(t);
+        std::unique_ptr<MockWorld>& mw = h.frames[content];
+        if (mw) continue;
+        mw.reset(new MockWorld(h.opt.width, h.opt.height, h.opt.depth, false));
+        FillSynthetic(*mw, h.opt.depth, content);
+    }
+    h.fill_ms += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+static PF_Err MockCheckinLayerPixels(PF_ProgPtr, A_long) { --g_host->layers_out; return PF_Err_NONE; }
+static PF_Err MockCheckoutOutput(PF_ProgPtr, PF_EffectWorld** out) {
+    if (!out) return PF_Err_BAD_CALLBACK_PARAM;
+    if (!g_host->output) g_host->output.reset(new MockWorld(g_host->opt.width, g_host->opt.height, g_host->opt.depth, true));
+    *out = &g_host->output->world;
+    return PF_Err_NONE;
+}
+
+static void InitHost(MockHost& h) {
+    std::memset(&h.basic, 0, sizeof(h.basic));
+    h.basic.AcquireSuite    = MockAcquireSuite;
+    h.basic.ReleaseSuite    = MockReleaseSuite;
+    h.basic.IsEqual         = MockIsEqual;
+    h.basic.AllocateBlock   = MockAllocateBlock;
+    h.basic.FreeBlock       = MockFreeBlock;
+    h.basic.ReallocateBlock = MockReallocateBlock;
+    h.basic.Undefined       = MockUndefined;
+
+    std::memset(&h.handle_suite, 0, sizeof(h.handle_suite));
+    h.handle_suite.host_new_handle      = MockNewHandle;
+    h.handle_suite.host_lock_handle     = MockLockHandle;
+    h.handle_suite.host_unlock_handle   = MockUnlockHandle;
+    h.handle_suite.host_dispose_handle  = MockDisposeHandle;
+    h.handle_suite.host_get_handle_size = MockGetHandleSize;
+    h.handle_suite.host_resize_handle   = MockResizeHandle;
+
+    std::memset(&h.ansi_suite, 0, sizeof(h.ansi_suite));
+    h.ansi_suite.sprintf = MockSprintf;
+    h.ansi_suite.strcpy  = MockStrcpy;
+    h.ansi_suite.atan  = [](A_FpLong v) -> A_FpLong { return std::atan(v); };
+    h.ansi_suite.atan2 = [](A_FpLong y, A_FpLong x) -> A_FpLong { return std::atan2(y, x); };
+    h.ansi_suite.ceil  = [](A_FpLong v) -> A_FpLong { return std::ceil(v); };
+    h.ansi_suite.cos   = [](A_FpLong v) -> A_FpLong { return std::cos(v); };
+    h.ansi_suite.exp   = [](A_FpLong v) -> A_FpLong { return std::exp(v); };
+    h.ansi_suite.fabs  = [](A_FpLong v) -> A_FpLong { return std::fabs(v); };
+    h.ansi_suite.floor = [](A_FpLong v) -> A_FpLong { return std::floor(v); };
+    h.ansi_suite.fmod  = [](A_FpLong a, A_FpLong b) -> A_FpLong { return std::fmod(a, b); };
+    h.ansi_suite.hypot = [](A_FpLong a, A_FpLong b) -> A_FpLong { return std::hypot(a, b); };
+    h.ansi_suite.log   = [](A_FpLong v) -> A_FpLong { return std::log(v); };
+    h.ansi_suite.log10 = [](A_FpLong v) -> A_FpLong { return std::log10(v); };
+    h.ansi_suite.pow   = [](A_FpLong a, A_FpLong b) -> A_FpLong { return std::pow(a, b); };
+    h.ansi_suite.sin   = [](A_FpLong v) -> A_FpLong { return std::sin(v); };
+    h.ansi_suite.sqrt  = [](A_FpLong v) -> A_FpLong { return std::sqrt(v); };
+    h.ansi_suite.tan   = [](A_FpLong v) -> A_FpLong { return std::tan(v); };
+    h.ansi_suite.asin  = [](A_FpLong v) -> A_FpLong { return std::asin(v); };
+    h.ansi_suite.acos  = [](A_FpLong v) -> A_FpLong { return std::acos(v); };
+
+    std::memset(&h.pre_cb, 0, sizeof(h.pre_cb));
+    h.pre_cb.checkout_layer = MockCheckoutLayer;
+    std::memset(&h.smart_cb, 0, sizeof(h.smart_cb));
+    h.smart_cb.checkout_layer_pixels = MockCheckoutLayerPixels;
+    h.smart_cb.checkin_layer_pixels  = MockCheckinLayerPixels;
+    h.smart_cb.checkout_output       = MockCheckoutOutput;
+
+    std::memset(&h.in_data, 0, sizeof(h.in_data));
+    h.in_data.inter.checkout_param = MockCheckoutParam;
+    h.in_data.inter.checkin_param  = MockCheckinParam;
+    h.in_data.inter.add_param      = MockAddParam;
+    h.in_data.effect_ref  = reinterpret_cast<PF_ProgPtr>(&h);
+    h.in_data.pica_basicP = &h.basic;
+    h.in_data.width  = h.opt.width;
+    h.in_data.height = h.opt.height;
+    h.in_data.time_step  = 1;
+    h.in_data.time_scale = 24;
+
+    // AE adds the input layer as param 0 before PARAMS_SETUP.
+    PF_ParamDef layer; std::memset(&layer, 0, sizeof(layer));
+    layer.param_type = PF_Param_LAYER;
+    h.params.push_back(layer);
+}
+
+// ---- Dispatch ---------------------------------------------------------------
+static PF_Err Send(MockHost& h, PF_Cmd cmd, void* extra = nullptr) {
+    std::memset(&h.out_data, 0, sizeof(h.out_data));
+    h.out_data.sequence_data = h.in_data.sequence_data;
+    h.out_data.global_data   = h.in_data.global_data;
+
+    std::vector<PF_ParamDef*> pp(h.params.size());
+    for (size_t i = 0; i < h.params.size(); ++i) pp[i] = &h.params[i];
+
+    const Clock::time_point t0 = Clock::now();
+    PF_Err err = EffectMain(cmd, &h.in_data, &h.out_data, pp.empty() ? nullptr : pp.data(),
+                                  h.output ? &h.output->world : nullptr, extra);
+    h.latency[cmd].add(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+    // Like AE, adopt sequence_data only from SEQUENCE_SETUP/RESETUP (and the flat
+    // handle from SEQUENCE_FLATTEN) and forget it after SEQUENCE_SETDOWN. A handle
+    // returned from anything else would never reach the render calls in AE, so
+    // the run fails rather than reporting hits AE cannot produce.
+    switch (cmd) {
+    case PF_Cmd_SEQUENCE_SETUP:
+    case PF_Cmd_SEQUENCE_RESETUP:
+    case PF_Cmd_SEQUENCE_FLATTEN:  h.in_data.sequence_data = h.out_data.sequence_data; break;
+    case PF_Cmd_SEQUENCE_SETDOWN:  h.in_data.sequence_data = nullptr; break;
+    default:
+        if (h.out_data.sequence_data != h.in_data.sequence_data) {
+            std::fprintf(stderr, "error: %s set sequence_data (AE only adopts it from SEQUENCE_SETUP/RESETUP)\n", CmdName(cmd));
+            if (!err) err = PF_Err_INTERNAL_STRUCT_DAMAGED;
+        }
+        break;
+    }
+    h.in_data.global_data = h.out_data.global_data;
+    if (err) std::fprintf(stderr, "error: %s returned %d\n", CmdName(cmd), (int)err);
+    return err;
+}
+
+static KuwaharaRenderStats SequenceStats(MockHost& h) {
+    KuwaharaRenderStats s; std::memset(&s, 0, sizeof(s));
+    if (h.in_data.sequence_data) {
+        if (auto* seq = reinterpret_cast<KuwaharaSequenceData*>(MockLockHandle(h.in_data.sequence_data))) {
+            s = seq->last_stats;
+            MockUnlockHandle(h.in_data.sequence_data);
+        }
+    }
+    return s;
+}
+
+static void Report(MockHost& h, const std::map<A_long, A_long>& sources, double wall_ms) {
+    std::printf("\n%-18s %6s %10s %10s %10s %10s\n", "command", "count", "mean ms", "min ms", "max ms", "total ms");
+    for (const auto& kv : h.latency) {
+        const Latency& l = kv.second;
+        std::printf("%-18s %6d %10.3f %10.3f %10.3f %10.1f\n", CmdName(kv.first), l.count,
+                    l.count ? l.total / l.count : 0.0, l.min, l.max, l.total);
+    }
+    std::printf("wall %.1f ms for %d frames (%.2f fps), excluding %.1f ms of test-card generation\n",
+                wall_ms, h.opt.frames, wall_ms > 0.0 ? 1000.0 * h.opt.frames / wall_ms : 0.0, h.fill_ms);
+    if (h.late_fills)
+        std::printf("note: %d frames were generated inside a timed command\n", h.late_fills);
+
+    std::printf("\ntensor source:");
+    for (A_long s = KUWAHARA_TENSOR_SOURCE_REUSED; s <= KUWAHARA_TENSOR_SOURCE_DISK; ++s) {
+        auto it = sources.find(s);
+        std::printf(" %s=%d", TensorSourceName(s), it == sources.end() ? 0 : it->second);
+    }
+    std::printf("\nhandles: created=%d disposed=%d live=%zu\n",
+                h.handles_created, h.handles_disposed, h.handles.size());
+    if (h.params_out || h.layers_out)
+        std::printf("unbalanced checkouts: params=%d layers=%d\n", h.params_out, h.layers_out);
+    for (const std::string& s : h.missing_suites) std::printf("missing suite requested: %s\n", s.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    MockHost host;
+    if (!ParseArgs(argc, argv, host.opt)) { Usage(argv[0]); return 2; }
+    g_host = &host;
+    InitHost(host);
+
+    // GlobalSetup reads the cache configuration from the environment.
+    if (host.opt.tensor_cache) setenv("SALIS_KUWAHARA_TENSOR_CACHE_DIR", host.opt.tensor_cache, 1);
+
+    PF_Err err = Send(host, PF_Cmd_GLOBAL_SETUP);
+    if (!err) err = Send(host, PF_Cmd_PARAMS_SETUP);
+    if (!err && (A_long)host.params.size() != KUWAHARA_NUM_PARAMS) {
+        std::fprintf(stderr, "error: PARAMS_SETUP added %zu params, expected %d\n", host.params.size(), (int)KUWAHARA_NUM_PARAMS);
+        err = PF_Err_INTERNAL_STRUCT_DAMAGED;
+    }
+    if (!err) err = Send(host, PF_Cmd_SEQUENCE_SETUP);
+    if (err) return 1;
+
+    for (const auto& p : host.opt.params) {
+        PF_ParamDef& d = host.params[p.first];
+        if      (d.param_type == PF_Param_CHECKBOX) d.u.bd.value = p.second != 0.0;
+        else if (d.param_type == PF_Param_POPUP)    d.u.pd.value = (A_long)p.second;
+        else                                        d.u.fs_d.value = p.second;
+    }
+
+    if (host.opt.csv) std::printf("frame,content,pre_render_ms,smart_render_ms,tensor,taps_per_px\n");
+    std::map<A_long, A_long> sources;
+    const Clock::time_point wall0 = Clock::now();
+    for (A_long f = 0; f < host.opt.frames && !err; ++f) {
+        if (host.opt.tweak_every > 0 && f > 0 && f % host.opt.tweak_every == 0) {
+            host.params[KUWAHARA_RADIUS].u.fs_d.value += 1.0;
+            err = Send(host, PF_Cmd_UPDATE_PARAMS_UI);
+        }
+        host.in_data.current_time = f;
+        host.layer_requests.clear();
+        PrepareFrames(host, f);
+
+        PF_RenderRequest req; std::memset(&req, 0, sizeof(req));
+        req.rect.right = host.opt.width; req.rect.bottom = host.opt.height;
+        req.channel_mask = PF_ChannelMask_ARGB;
+        PF_PreRenderInput pre_in; std::memset(&pre_in, 0, sizeof(pre_in));
+        pre_in.output_request = req;
+        pre_in.bitdepth = (short)host.opt.depth;
+        PF_PreRenderOutput pre_out; std::memset(&pre_out, 0, sizeof(pre_out));
+        PF_PreRenderExtra pre; pre.input = &pre_in; pre.output = &pre_out; pre.cb = &host.pre_cb;
+        if (!err) err = Send(host, PF_Cmd_SMART_PRE_RENDER, &pre);
+
+        PF_SmartRenderInput smart_in; std::memset(&smart_in, 0, sizeof(smart_in));
+        smart_in.output_request = req;
+        smart_in.bitdepth = (short)host.opt.depth;
+        smart_in.pre_render_data = pre_out.pre_render_data;
+        PF_SmartRenderExtra smart; smart.input = &smart_in; smart.cb = &host.smart_cb;
+        if (!err) err = Send(host, PF_Cmd_SMART_RENDER, &smart);
+        if (err) break;
+
+        const KuwaharaRenderStats st = SequenceStats(host);
+        ++sources[st.tensor_source];
+        if (host.opt.csv)
+            std::printf("%d,%d,%.3f,%.3f,%s,%.1f\n", f, ContentId(f),
+                        host.latency[PF_Cmd_SMART_PRE_RENDER].last, host.latency[PF_Cmd_SMART_RENDER].last,
+                        TensorSourceName(st.tensor_source), st.mean_taps_per_pixel);
+        if (host.opt.pace_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(host.opt.pace_ms));
+    }
+    const double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - wall0).count() - host.fill_ms;
+
+    if (Send(host, PF_Cmd_SEQUENCE_SETDOWN) && !err) err = PF_Err_INTERNAL_STRUCT_DAMAGED;
+    if (Send(host, PF_Cmd_GLOBAL_SETDOWN)   && !err) err = PF_Err_INTERNAL_STRUCT_DAMAGED;
+
+    Report(host, sources, wall_ms);
+    const bool leaked = !host.handles.empty() || host.params_out || host.layers_out;
+    for (MockHandle* hd : host.handles) { std::free(hd->ptr); delete hd; }
+    return (err || leaked) ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Salis Kuwahara Filter mock host build script
+# Builds EffectMain + KuwaharaCore into a standalone executable that stands in
+# for After Effects (Linux / macOS, no AE install needed). Profiling only.
+#
+#   AE_SDK="$HOME/.../AfterEffectsSDK/Examples" ./HostHarness/build_mock_host.sh
+#   ./HostHarness/mock_host --size 1920x1080 --frames 48 --prefetch 1 --pace 40
+
+cd "$(dirname "$0")/.." || exit 1
+
+if [ -z "$AE_SDK" ]; then
+    echo "Set AE_SDK to the AfterEffectsSDK/Examples directory."
+    exit 1
+fi
+
+CXX="${CXX:-c++}"
+OUT="${OUT:-HostHarness/mock_host}"
+# The SDK headers only know Mac and Windows; the Mac branch is plain C on other
+# Unix hosts as long as the CoreGraphics defines stay off.
+PLATFORM_DEFS="${PLATFORM_DEFS:--DAE_OS_MAC=1 -DPF_DEEP_COLOR_AWARE=1}"
+OPENMP_FLAGS="${OPENMP_FLAGS:--fopenmp}"
+
+echo "Building mock host -> $OUT"
+
+$CXX -std=c++17 -O2 -g -pthread $OPENMP_FLAGS $PLATFORM_DEFS \
+    -I AEAdapter -I KuwaharaCore \
+    -I "$AE_SDK/Headers" -I "$AE_SDK/Headers/SP" -I "$AE_SDK/Util" -I "$AE_SDK/Resources" \
+    HostHarness/MockHost.cpp \
+    AEAdapter/EffectMain.cpp AEAdapter/Strings.cpp \
+    KuwaharaCore/Process.cpp KuwaharaCore/TensorDiskCache.cpp \
+    "$AE_SDK/Util/AEGP_SuiteHandler.cpp" "$AE_SDK/Util/MissingSuiteError.cpp" \
+    -o "$OUT"
+
+if [ $? -eq 0 ]; then
+    echo "Build succeeded!"
+else
+    echo "Build failed. Please check the error messages above."
+    exit 1
+fi
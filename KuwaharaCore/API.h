@@ -8,6 +8,23 @@
 #include "AE_Effect.h"
 #include "AE_GeneralPlug.h"
 
+// ---- Render statistics (filled on return when requested) ----
+typedef struct {
+    A_long        stencil_taps;          // full stencil taps per pixel
+    A_long        scheduled_taps;        // taps per pixel after budgeting
+    A_u_longlong  total_taps;            // taps actually read (in-bounds), all passes
+    PF_FpLong     mean_taps_per_pixel;   // per pass
+    A_long        tensor_source;         // KUWAHARA_TENSOR_SOURCE_*
+} KuwaharaRenderStats;
+
+// Where the frame's structure tensor came from
+enum {
+    KUWAHARA_TENSOR_SOURCE_REUSED = 0,   // sequence cache hit
+    KUWAHARA_TENSOR_SOURCE_COMPUTED,
+    KUWAHARA_TENSOR_SOURCE_PREFETCH,
+    KUWAHARA_TENSOR_SOURCE_DISK
+};
+
 // ---- Sequence cache (unified across all translation units) ----
 typedef struct {
     A_long     version;
@@ -17,12 +34,43 @@ typedef struct {
     PF_FpLong  cached_anisotropy;
     void*      structure_tensor_data;   // opaque
     A_Boolean  needs_recompute;
+    KuwaharaRenderStats last_stats;     // from the most recent SmartRender
+    void*      tensor_prefetch;         // opaque, see CreateTensorPrefetcher
+    void*      pass_scratch;            // opaque, Iterations > 1 only; free with DeletePassScratch
 } KuwaharaSequenceData;
 
+// ---- Render options (zero-initialised = legacy behaviour) ----
+#define KUWAHARA_ITERATIONS_MAX  8       // also the AE control's upper bound
+
+typedef struct {
+    A_Boolean     area_sampling;         // fixed taps/sector read from a moment mip-map
+    A_long        tap_budget;            // max taps per pixel (0 or >= 5/6 of the stencil = full, min 1 per sector)
+    A_u_longlong  frame_tap_budget;      // max taps per frame over all passes (0 = unlimited); API only, no AE control
+    A_long        iterations;            // fused sector passes (0/1 = single pass, clamped to KUWAHARA_ITERATIONS_MAX)
+    A_long        tensor_scale;          // structure tensor at 1/1, 1/2 or 1/4 (0 = full)
+    A_Boolean     tiled_source;          // point taps read a tiled copy, output walked in blocks
+    KuwaharaRenderStats* stats;          // optional output
+} KuwaharaRenderOptions;
+
 // Opaque tensor
 void* CreateStructureTensorField();
 void  DeleteStructureTensorField(void* field);
 
+// Iteration scratch (allocated by the core into KuwaharaSequenceData::pass_scratch)
+void  DeletePassScratch(void* scratch);
+
+// Persistent tensor cache (off until configured; empty dir or 0 bytes disables)
+void ConfigureTensorDiskCache(const char* directory, A_u_longlong max_bytes);
+
+// Background tensor prefetch (one per instance; pending work is dropped when
+// size, depth or tensor_scale change)
+void* CreateTensorPrefetcher();
+void  DeleteTensorPrefetcher(void* prefetcher);
+A_Boolean TensorPrefetchHasRoom(void* prefetcher);   // FALSE if null or backlogged
+void  PrefetchStructureTensor8   (void* prefetcher, const PF_EffectWorld* upcoming, A_long tensor_scale);
+void  PrefetchStructureTensor16  (void* prefetcher, const PF_EffectWorld* upcoming, A_long tensor_scale);
+void  PrefetchStructureTensor32f (void* prefetcher, const PF_EffectWorld* upcoming, A_long tensor_scale);
+
 // Tensor computation per depth
 void ComputeStructureTensorField8   (const PF_EffectWorld* input, void* field_ptr);
 void ComputeStructureTensorField16  (const PF_EffectWorld* input, void* field_ptr);
@@ -32,22 +80,22 @@ void ComputeStructureTensorField32f (const PF_EffectWorld* input, void* field_pt
 PF_Err ProcessKuwaharaWorld8Smart(
     PF_InData*, PF_EffectWorld* in, PF_EffectWorld* out,
     A_long radius, A_long sectorCount, PF_FpLong aniso, PF_FpLong soft, PF_FpLong mix,
-    void* seq_data_ptr);
+    const KuwaharaRenderOptions* opts, void* seq_data_ptr);
 
 PF_Err ProcessKuwaharaWorld16Smart(
     PF_InData*, PF_EffectWorld* in, PF_EffectWorld* out,
     A_long radius, A_long sectorCount, PF_FpLong aniso, PF_FpLong soft, PF_FpLong mix,
-    void* seq_data_ptr);
+    const KuwaharaRenderOptions* opts, void* seq_data_ptr);
 
 PF_Err ProcessKuwaharaWorld32fSmart(
     PF_InData*, PF_EffectWorld* in, PF_EffectWorld* out,
     A_long radius, A_long sectorCount, PF_FpLong aniso, PF_FpLong soft, PF_FpLong mix,
-    void* seq_data_ptr);
+    const KuwaharaRenderOptions* opts, void* seq_data_ptr);
 
 // Legacy (non-smart) wrappers
-PF_Err ProcessKuwaharaWorld8 (PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong);
-PF_Err ProcessKuwaharaWorld16(PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong);
-PF_Err ProcessKuwaharaWorld32f(PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong);
+PF_Err ProcessKuwaharaWorld8 (PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong, const KuwaharaRenderOptions*);
+PF_Err ProcessKuwaharaWorld16(PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong, const KuwaharaRenderOptions*);
+PF_Err ProcessKuwaharaWorld32f(PF_InData*, PF_EffectWorld*, PF_EffectWorld*, A_long, A_long, PF_FpLong, PF_FpLong, PF_FpLong, const KuwaharaRenderOptions*);
 
 #endif
 
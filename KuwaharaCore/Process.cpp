@@ -2,6 +2,7 @@
 /* Kuwahara Core Algorithm — final build-safe implementation       */
 /*******************************************************************/
 #include "API.h"
+#include "TensorDiskCache.h"
 
 #if defined(__clang__)
   #pragma clang diagnostic push
@@ -16,6 +17,14 @@
 
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <vector>
 
 #ifdef _OPENMP
@@ -30,17 +39,67 @@
 #endif
 
 // ---- Structure tensor field -------------------------------------------------
+// Reads go through the p* views, which point either at the owned vectors or at
+// a read-only mapping from the disk cache.
 struct StructureTensorField {
     std::vector<float> e1, e2, vx, vy;
+    const float *pe1=nullptr, *pe2=nullptr, *pvx=nullptr, *pvy=nullptr;
+    TensorDiskMapping mapped;
+    A_u_longlong content_key=0;   // input hash when the disk cache is on, else 0
     A_long w=0, h=0;
+    A_long scale=1;               // field texel = scale x scale input pixels
+    ~StructureTensorField() { TensorDiskCache_Unmap(mapped); }
     void init(A_long W, A_long H) {
+        TensorDiskCache_Unmap(mapped);
         w=W; h=H;
         const size_t N = static_cast<size_t>(W)*H;
         e1.assign(N,0.f); e2.assign(N,0.f); vx.assign(N,1.f); vy.assign(N,0.f);
+        pe1=e1.data(); pe2=e2.data(); pvx=vx.data(); pvy=vy.data();
     }
+    void adopt(const TensorDiskMapping& m) {
+        TensorDiskCache_Unmap(mapped);
+        std::vector<float>().swap(e1); std::vector<float>().swap(e2);
+        std::vector<float>().swap(vx); std::vector<float>().swap(vy);
+        mapped=m; w=m.w; h=m.h;
+        pe1=m.e1; pe2=m.e2; pvx=m.vx; pvy=m.vy;
+    }
+    void takeFrom(StructureTensorField& o) {
+        TensorDiskCache_Unmap(mapped);
+        e1.swap(o.e1); e2.swap(o.e2); vx.swap(o.vx); vy.swap(o.vy);
+        w=o.w; h=o.h; scale=o.scale;
+        pe1=e1.data(); pe2=e2.data(); pvx=vx.data(); pvy=vy.data();
+    }
+    // (x,y) in input pixels.
     inline void get(A_long x, A_long y, float& _e1, float& _e2, float& _vx, float& _vy) const {
+        if (scale>1) { getScaled(x,y,_e1,_e2,_vx,_vy); return; }
         const size_t i = static_cast<size_t>(y)*w + static_cast<size_t>(x);
-        _e1=e1[i]; _e2=e2[i]; _vx=vx[i]; _vy=vy[i];
+        _e1=pe1[i]; _e2=pe2[i]; _vx=pvx[i]; _vy=pvy[i];
+    }
+    // Bilinear lookup into a reduced-resolution field. Eigenvectors are
+    // sign-ambiguous, so each texel's is flipped onto the first before blending;
+    // the blend keeps the interpolated length (weak tensors store short vectors).
+    void getScaled(A_long x, A_long y, float& _e1, float& _e2, float& _vx, float& _vy) const {
+        const float inv = 1.0f/(float)scale;
+        const float u = std::max(0.f, std::min((float)(w-1), ((float)x+0.5f)*inv - 0.5f));
+        const float v = std::max(0.f, std::min((float)(h-1), ((float)y+0.5f)*inv - 0.5f));
+        const A_long x0=(A_long)u, y0=(A_long)v;
+        const A_long x1=std::min<A_long>(x0+1, w-1), y1=std::min<A_long>(y0+1, h-1);
+        const float fx=u-(float)x0, fy=v-(float)y0;
+        const size_t idx[4] = { static_cast<size_t>(y0)*w+x0, static_cast<size_t>(y0)*w+x1,
+                                static_cast<size_t>(y1)*w+x0, static_cast<size_t>(y1)*w+x1 };
+        const float wt[4] = { (1.f-fx)*(1.f-fy), fx*(1.f-fy), (1.f-fx)*fy, fx*fy };
+        const float rx=pvx[idx[0]], ry=pvy[idx[0]];
+        float a=0.f, b=0.f, ox=0.f, oy=0.f, len=0.f;
+        for (int k=0;k<4;++k){
+            const size_t i=idx[k];
+            const float sgn = (pvx[i]*rx + pvy[i]*ry) < 0.f ? -wt[k] : wt[k];
+            a += wt[k]*pe1[i]; b += wt[k]*pe2[i];
+            ox += sgn*pvx[i];  oy += sgn*pvy[i];
+            len += wt[k]*std::sqrt(pvx[i]*pvx[i] + pvy[i]*pvy[i]);
+        }
+        const float n = std::sqrt(ox*ox + oy*oy);
+        _e1=a; _e2=b;
+        if (n>1e-12f){ _vx=ox*len/n; _vy=oy*len/n; } else { _vx=rx; _vy=ry; }
     }
 };
 
@@ -88,23 +147,55 @@ static void BoxBlur(std::vector<float>& img, A_long W, A_long H, int K) {
 }
 
 // ---- Structure tensor (8/16/32f) -------------------------------------------
-static void ComputeST_Generic(const PF_EffectWorld* in, StructureTensorField* f, float(*L)(const PF_EffectWorld*,A_long,A_long)){
+static const int kTensorBlurTaps = 5;   // at full resolution
+
+// Tensor resolution: 1 (full), 2 (half) or 4 (quarter).
+static inline A_long TensorScale(A_long s) { return (s==2 || s==4) ? s : 1; }
+static inline A_long TensorDim(A_long full, A_long scale) { return (full + scale - 1) / scale; }
+
+// Blur width in field texels, keeping roughly the same footprint in input pixels.
+static inline int TensorBlurTaps(A_long scale) { return std::max(1, (int)(kTensorBlurTaps / scale)) | 1; }
+
+// Luma at 1/scale resolution (box average of each scale x scale block).
+static void ExtractLuma(const PF_EffectWorld* in, float(*L)(const PF_EffectWorld*,A_long,A_long), A_long scale,
+                        std::vector<float>& luma, A_long& w, A_long& h){
     const A_long W=in->width,H=in->height;
+    w=TensorDim(W,scale); h=TensorDim(H,scale);
+    luma.resize(static_cast<size_t>(w)*h);
+#if USE_OPENMP
+#pragma omp parallel for
+#endif
+    for (A_long y=0;y<h;++y){
+        for (A_long x=0;x<w;++x){
+            if (scale==1) { luma[static_cast<size_t>(y)*w+x]=L(in,x,y); continue; }
+            const A_long sx0=x*scale, sy0=y*scale;
+            const A_long sx1=std::min<A_long>(sx0+scale, W), sy1=std::min<A_long>(sy0+scale, H);
+            float sum=0.f;
+            for (A_long yy=sy0;yy<sy1;++yy) for (A_long xx=sx0;xx<sx1;++xx) sum+=L(in,xx,yy);
+            luma[static_cast<size_t>(y)*w+x]=sum/(float)((sx1-sx0)*(sy1-sy0));
+        }
+    }
+}
+
+static void ComputeST_FromLuma(const float* Y, A_long W, A_long H, A_long scale, StructureTensorField* f){
     f->init(W,H);
+    f->scale=scale;
     std::vector<float> Ix(static_cast<size_t>(W)*H), Iy(static_cast<size_t>(W)*H);
+    const float g = 0.5f/(float)scale;   // central difference, per input pixel
 
 #if USE_OPENMP
 #pragma omp parallel for
 #endif
     for (A_long y=0;y<H;++y){
+        const float* row=Y+static_cast<size_t>(y)*W;
         for (A_long x=0;x<W;++x){
-            float c=L(in,x,y);
-            float r=(x<W-1)?L(in,x+1,y):c;
-            float l=(x>0)  ?L(in,x-1,y):c;
-            float d=(y<H-1)?L(in,x,y+1):c;
-            float u=(y>0)  ?L(in,x,y-1):c;
-            Ix[static_cast<size_t>(y)*W+x]=(r-l)*0.5f;
-            Iy[static_cast<size_t>(y)*W+x]=(d-u)*0.5f;
+            float c=row[x];
+            float r=(x<W-1)?row[x+1]:c;
+            float l=(x>0)  ?row[x-1]:c;
+            float d=(y<H-1)?row[x+W]:c;
+            float u=(y>0)  ?row[x-W]:c;
+            Ix[static_cast<size_t>(y)*W+x]=(r-l)*g;
+            Iy[static_cast<size_t>(y)*W+x]=(d-u)*g;
         }
     }
 
@@ -120,7 +211,7 @@ static void ComputeST_Generic(const PF_EffectWorld* in, StructureTensorField* f,
         }
     }
 
-    const int K=5; BoxBlur(Jxx,W,H,K); BoxBlur(Jxy,W,H,K); BoxBlur(Jyy,W,H,K);
+    const int K=TensorBlurTaps(scale); BoxBlur(Jxx,W,H,K); BoxBlur(Jxy,W,H,K); BoxBlur(Jyy,W,H,K);
 
 #if USE_OPENMP
 #pragma omp parallel for
@@ -141,9 +232,190 @@ static void ComputeST_Generic(const PF_EffectWorld* in, StructureTensorField* f,
     }
 }
 
-void ComputeStructureTensorField8   (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma8 ); }
-void ComputeStructureTensorField16  (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma16); }
-void ComputeStructureTensorField32f (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma32f); }
+static void ComputeST_Generic(const PF_EffectWorld* in, StructureTensorField* f, float(*L)(const PF_EffectWorld*,A_long,A_long), A_long scale){
+    std::vector<float> luma; A_long w=0, h=0;
+    ExtractLuma(in, L, scale, luma, w, h);
+    ComputeST_FromLuma(luma.data(), w, h, scale, f);
+}
+
+void ComputeStructureTensorField8   (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma8 , 1); }
+void ComputeStructureTensorField16  (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma16, 1); }
+void ComputeStructureTensorField32f (const PF_EffectWorld* in, void* fp){ ComputeST_Generic(in, reinterpret_cast<StructureTensorField*>(fp), &Luma32f, 1); }
+
+// ---- Background tensor prefetch ---------------------------------------------
+// Per-instance worker that computes tensors for frames the host has already
+// handed us (the next frame, checked out in PreRender) so playback only pays
+// the sector stage on the critical path. The render thread only copies the
+// pixels into a recycled buffer; hashing, luma extraction and the tensor all
+// run on the worker. Work is bounded (kPrefetchMaxQueued pending jobs,
+// kPrefetchMaxReady finished fields) and dropped wholesale by a generation
+// bump when the tensor's inputs (size, depth, tensor scale) change.
+static const size_t kPrefetchMaxQueued = 2;
+static const size_t kPrefetchMaxReady  = 3;
+
+struct TensorPrefetcher {
+    typedef float (*LumaFn)(const PF_EffectWorld*,A_long,A_long);
+    struct Job   { PF_EffectWorld view; std::vector<char> pixels; size_t pixelBytes=0; LumaFn L=nullptr;
+                   std::uint64_t settings=0; A_long scale=1; unsigned gen=0; };
+    struct Ready { TensorCacheKey key; std::unique_ptr<StructureTensorField> field; };
+
+    std::mutex              mtx;
+    std::condition_variable cv;
+    std::deque<Job>         queue;
+    std::deque<Ready>       ready;          // oldest first
+    std::vector<std::vector<char>> spare;   // pixel buffers for reuse
+    TensorCacheKey          running;
+    bool                    busy = false;
+    bool                    quit = false;
+    std::atomic<unsigned>   gen{0};
+    std::uint64_t           inputSettings = 0;   // what queued work was keyed on
+    A_long                  inputW = 0, inputH = 0;
+    std::thread             worker;
+
+    ~TensorPrefetcher() {
+        { std::lock_guard<std::mutex> lock(mtx); quit = true; queue.clear(); }
+        cv.notify_all();
+        if (worker.joinable()) worker.join();
+    }
+
+    static bool Same(const TensorCacheKey& a, const TensorCacheKey& b) {
+        return a.content==b.content && a.settings==b.settings;
+    }
+
+    bool knownLocked(const TensorCacheKey& k) const {
+        if (busy && Same(running, k)) return true;
+        for (const Ready& r : ready) if (Same(r.key, k)) return true;
+        return false;
+    }
+
+    void cancelLocked() {
+        gen.fetch_add(1);
+        for (Job& j : queue) recycleLocked(j.pixels);
+        queue.clear();
+        ready.clear();
+    }
+
+    void recycleLocked(std::vector<char>& buf) {
+        if (spare.size() <= kPrefetchMaxQueued) spare.push_back(std::move(buf));
+    }
+
+    std::vector<char> spareBuffer() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (spare.empty()) return std::vector<char>();
+        std::vector<char> buf = std::move(spare.back());
+        spare.pop_back();
+        return buf;
+    }
+
+    // A new job for the next frame is worth the copy only while the worker
+    // keeps up; a backlog would be stale by the time it is reached.
+    bool hasRoom() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return !quit && queue.size() < kPrefetchMaxQueued;
+    }
+
+    void enqueue(Job&& job) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (quit) return;
+            if (job.settings != inputSettings || job.view.width != inputW || job.view.height != inputH) {
+                cancelLocked();   // queued and finished work is for other tensor inputs
+                inputSettings = job.settings; inputW = job.view.width; inputH = job.view.height;
+            }
+            if (queue.size() >= kPrefetchMaxQueued) {   // newest frame wins
+                recycleLocked(queue.front().pixels);
+                queue.pop_front();
+            }
+            job.gen = gen.load();
+            queue.push_back(std::move(job));
+            if (!worker.joinable()) worker = std::thread(&TensorPrefetcher::run, this);
+        }
+        cv.notify_one();
+    }
+
+    // Moves a finished field into dst. Returns false on miss.
+    bool take(const TensorCacheKey& k, StructureTensorField* dst) {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto it = ready.begin(); it != ready.end(); ++it) {
+            if (!Same(it->key, k)) continue;
+            dst->takeFrom(*it->field);
+            ready.erase(it);
+            return true;
+        }
+        return false;
+    }
+
+    void run() {
+#if USE_OPENMP
+        omp_set_num_threads(std::max(1, omp_get_num_procs()/2));   // leave the render thread headroom
+#endif
+        std::vector<float> luma;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]{ return quit || !queue.empty(); });
+                if (quit) return;
+                job = std::move(queue.front()); queue.pop_front();
+            }
+
+            TensorCacheKey key;
+            key.content  = TensorDiskCache_HashWorld(&job.view, job.pixelBytes);
+            key.settings = job.settings;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (job.gen != gen.load() || knownLocked(key)) { recycleLocked(job.pixels); continue; }
+                running = key; busy = true;
+            }
+
+            std::unique_ptr<StructureTensorField> f(new StructureTensorField());
+            if (job.gen == gen.load()) {
+                A_long w=0, h=0;
+                ExtractLuma(&job.view, job.L, job.scale, luma, w, h);
+                ComputeST_FromLuma(luma.data(), w, h, job.scale, f.get());
+            }
+
+            std::lock_guard<std::mutex> lock(mtx);
+            busy = false;
+            recycleLocked(job.pixels);
+            if (job.gen != gen.load() || quit) continue;               // cancelled mid-flight
+            if (ready.size() >= kPrefetchMaxReady) ready.pop_front();
+            ready.push_back(Ready{ key, std::move(f) });
+        }
+    }
+};
+
+void* CreateTensorPrefetcher()              { return new TensorPrefetcher(); }
+void  DeleteTensorPrefetcher(void* p)       { delete reinterpret_cast<TensorPrefetcher*>(p); }
+A_Boolean TensorPrefetchHasRoom(void* p)    { return (p && reinterpret_cast<TensorPrefetcher*>(p)->hasRoom()) ? TRUE : FALSE; }
+
+static void Prefetch_Generic(void* p, const PF_EffectWorld* upcoming, size_t pixelBytes,
+                             TensorPrefetcher::LumaFn L, A_long tensorScale){
+    if (!p || !upcoming || !upcoming->data || upcoming->width <= 0 || upcoming->height <= 0) return;
+    TensorPrefetcher* pf = reinterpret_cast<TensorPrefetcher*>(p);
+    TensorPrefetcher::Job job;
+    job.scale      = TensorScale(tensorScale);
+    job.pixelBytes = pixelBytes;
+    job.L          = L;
+    job.settings   = TensorDiskCache_HashSettings((std::uint32_t)pixelBytes, kTensorBlurTaps, (std::uint32_t)job.scale);
+
+    // Pixels are only valid during this render call: copy the rows as they
+    // are and leave everything else to the worker.
+    const size_t rowBytes = static_cast<size_t>(upcoming->width)*pixelBytes;
+    job.pixels = pf->spareBuffer();
+    job.pixels.resize(rowBytes*upcoming->height);
+    for (A_long y=0;y<upcoming->height;++y)
+        std::memcpy(job.pixels.data() + rowBytes*y,
+                    reinterpret_cast<const char*>(upcoming->data) + static_cast<std::ptrdiff_t>(y)*upcoming->rowbytes, rowBytes);
+    job.view          = *upcoming;
+    job.view.data     = reinterpret_cast<decltype(job.view.data)>(job.pixels.data());
+    job.view.rowbytes = (A_long)rowBytes;
+    pf->enqueue(std::move(job));
+}
+
+void PrefetchStructureTensor8   (void* p, const PF_EffectWorld* w, A_long ts){ Prefetch_Generic(p, w, sizeof(PF_Pixel8),     &Luma8 , ts); }
+void PrefetchStructureTensor16  (void* p, const PF_EffectWorld* w, A_long ts){ Prefetch_Generic(p, w, sizeof(PF_Pixel16),    &Luma16, ts); }
+void PrefetchStructureTensor32f (void* p, const PF_EffectWorld* w, A_long ts){ Prefetch_Generic(p, w, sizeof(PF_PixelFloat), &Luma32f, ts); }
 
 // ---- Pixel I/O (no templates → no deduction issues) -------------------------
 static inline void fetchRGB(const PF_Pixel8* p,  float inv, float& r,float& g,float& b){ r=p->red*inv;   g=p->green*inv;   b=p->blue*inv; }
@@ -166,13 +438,210 @@ static inline void storeRGB(PF_PixelFloat* p, float r,float g,float b){
     p->blue = std::max(0.f,std::min(1.f,b));
 }
 
+// ---- Moment mip-map (area sampling) ----------------------------------------
+// Level L stores box-filtered R,G,B,R²,G²,B² (interleaved) over 2^L x 2^L
+// source pixels, so one trilinear read returns the first and second moments
+// of a whole footprint and the sector variance stays exact under averaging.
+static const int kMipRings      = 4;   // equal-area rings per sector
+static const int kMipAngularTaps= 3;   // taps per ring
+
+struct MomentPyramid {
+    struct Level { A_long w=0, h=0; std::vector<float> m; };
+    std::vector<Level> levels;
+
+    template<typename PIX>
+    void build(const PF_EffectWorld* in, float invMax) {
+        levels.clear();
+        Level base; base.w=in->width; base.h=in->height;
+        base.m.resize(static_cast<size_t>(base.w)*base.h*6);
+#if USE_OPENMP
+#pragma omp parallel for
+#endif
+        for (A_long y=0;y<base.h;++y){
+            const PIX* row = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(in->data) + y*in->rowbytes);
+            float* dst = &base.m[static_cast<size_t>(y)*base.w*6];
+            for (A_long x=0;x<base.w;++x, dst+=6){
+                float r,g,b; fetchRGB(&row[x], invMax, r,g,b);
+                dst[0]=r; dst[1]=g; dst[2]=b; dst[3]=r*r; dst[4]=g*g; dst[5]=b*b;
+            }
+        }
+        levels.push_back(std::move(base));
+
+        while (levels.back().w>1 || levels.back().h>1){
+            const Level& src = levels.back();
+            Level dst; dst.w=(src.w+1)/2; dst.h=(src.h+1)/2;
+            dst.m.resize(static_cast<size_t>(dst.w)*dst.h*6);
+#if USE_OPENMP
+#pragma omp parallel for
+#endif
+            for (A_long y=0;y<dst.h;++y){
+                const A_long y0=2*y, y1=std::min<A_long>(2*y+1, src.h-1);
+                for (A_long x=0;x<dst.w;++x){
+                    const A_long x0=2*x, x1=std::min<A_long>(2*x+1, src.w-1);
+                    const float* a=&src.m[(static_cast<size_t>(y0)*src.w+x0)*6];
+                    const float* b=&src.m[(static_cast<size_t>(y0)*src.w+x1)*6];
+                    const float* c=&src.m[(static_cast<size_t>(y1)*src.w+x0)*6];
+                    const float* d=&src.m[(static_cast<size_t>(y1)*src.w+x1)*6];
+                    float* o=&dst.m[(static_cast<size_t>(y)*dst.w+x)*6];
+                    for (int k=0;k<6;++k) o[k]=0.25f*(a[k]+b[k]+c[k]+d[k]);
+                }
+            }
+            levels.push_back(std::move(dst));
+        }
+    }
+
+    // Bilinear read at level L; (x,y) in level-0 pixel coordinates.
+    inline void bilinear(int L, float x, float y, float* out) const {
+        const Level& lv = levels[L];
+        const float s = 1.0f / (float)(1 << L);
+        float u = (x+0.5f)*s - 0.5f, v = (y+0.5f)*s - 0.5f;
+        u = std::max(0.f, std::min((float)(lv.w-1), u));
+        v = std::max(0.f, std::min((float)(lv.h-1), v));
+        const A_long x0=(A_long)u, y0=(A_long)v;
+        const A_long x1=std::min<A_long>(x0+1, lv.w-1), y1=std::min<A_long>(y0+1, lv.h-1);
+        const float fx=u-(float)x0, fy=v-(float)y0;
+        const float* a=&lv.m[(static_cast<size_t>(y0)*lv.w+x0)*6];
+        const float* b=&lv.m[(static_cast<size_t>(y0)*lv.w+x1)*6];
+        const float* c=&lv.m[(static_cast<size_t>(y1)*lv.w+x0)*6];
+        const float* d=&lv.m[(static_cast<size_t>(y1)*lv.w+x1)*6];
+        for (int k=0;k<6;++k){
+            const float top=a[k]+(b[k]-a[k])*fx, bot=c[k]+(d[k]-c[k])*fx;
+            out[k]=top+(bot-top)*fy;
+        }
+    }
+
+    // Trilinear read; footprint is the tap's width in level-0 pixels.
+    inline void sample(float x, float y, float footprint, float* out) const {
+        const float maxLod = (float)(levels.size()-1);
+        const float lod = std::min(maxLod, std::log2(std::max(1.f, footprint)));
+        const int   L0  = (int)lod;
+        const float t   = lod - (float)L0;
+        bilinear(L0, x, y, out);
+        if (t>1e-3f && L0+1<(int)levels.size()){
+            float hi[6]; bilinear(L0+1, x, y, hi);
+            for (int k=0;k<6;++k) out[k]+= (hi[k]-out[k])*t;
+        }
+    }
+};
+
+// ---- Tap budget -------------------------------------------------------------
+static const int   kPointAngularTaps = 5;   // angular taps per ring (point stencil)
+static const float kGoldenRatioConj  = 0.618033988749895f;
+
+static inline float Fract(float v) { return v - std::floor(v); }
+
+// Jimenez' interleaved gradient noise: deterministic, cheap, and free of the
+// low-frequency structure that would show up as banding in the tap subsets.
+static inline float InterleavedGradientNoise(A_long x, A_long y) {
+    return Fract(52.9829189f * Fract(0.06711056f*(float)x + 0.00583715f*(float)y));
+}
+
+// Per-pixel budgets that keep at least this fraction of the stencil use all
+// of it: a subset tap costs ~1.2x a full-stencil tap (its image reads vary per
+// pixel, so neighbours share fewer cache lines), so above ~5/6 it saves no
+// time. Frame budgets are hard caps and never round up.
+static const A_long kBudgetFullNum = 5, kBudgetFullDen = 6;
+
+// Step along the angle axis: the integer nearest angles/golden ratio that is
+// coprime to angles, so (a0 + n*step) mod angles visits every angle before
+// repeating one.
+static A_long CoprimeStep(A_long angles) {
+    if (angles <= 1) return 0;
+    A_long g = std::max<A_long>(1, (A_long)std::lround((float)angles * kGoldenRatioConj));
+    while (std::gcd(g, angles) != 1) ++g;
+    return g % angles;
+}
+
+// M distinct taps of a rings x angles stencil (M < rings*angles), walked in
+// ring order. Tap n sits in ring floor((n*rings + o)/M), o in [0,rings) being
+// the per-pixel jitter, and at angle (a0 + n*step) mod angles. Taps sharing a
+// ring are fewer than `angles` apart in n, so with step coprime to angles they
+// never repeat a cell, and successive rings rotate instead of stacking on one
+// ray. Only integer increments per tap, so a kept tap costs about what a
+// full-stencil tap does.
+struct TapWalk {
+    A_long M, rings, angles, step;
+    A_long ring, angle, acc;   // acc = (n*rings + o) mod M
+
+    TapWalk(A_long M_, A_long rings_, A_long angles_, A_long step_, float u, float v)
+        : M(M_), rings(rings_), angles(angles_), step(step_) {
+        const A_long o = std::min<A_long>((A_long)(u * (float)rings), rings-1);
+        ring  = o / M; acc = o % M;
+        angle = std::min<A_long>((A_long)(v * (float)angles), angles-1);
+    }
+    inline void next() {
+        acc += rings;
+        if (rings < M) {   // at most one ring per tap: keep it branch-free
+            const A_long wrap = (acc >= M);
+            acc -= wrap*M; ring += wrap;
+        } else {
+            while (acc >= M) { acc -= M; ++ring; }
+        }
+        angle += step;
+        angle -= (angle >= angles)*angles;
+    }
+};
+
+// ---- Tiled source layout ----------------------------------------------------
+// A rotated, stretched stencil lands each tap on a different row of a
+// row-major world, so nearly every gather is a new cache line (and, past a
+// few rows, a new page). Copying the source into tiles one cache line wide and
+// eight rows tall keeps taps that are close in any direction within a few
+// pages, while a line still spans as many pixels along x as before. Pixels
+// are unchanged; only their addresses are.
+static const A_long kTileRowShift = 3;                     // 8 rows per tile
+static const A_long kTileRowMask  = (1 << kTileRowShift) - 1;
+static const A_long kBlockDim     = 64;                    // output block edge with tiles on
+
+template<typename PIX>
+struct TiledSource {
+    // 64-byte line: 16 (8 bpc), 8 (16 bpc) or 4 (32f) pixels per tile row
+    static const A_long kColShift = sizeof(PIX)>=16 ? 2 : (sizeof(PIX)>=8 ? 3 : 4);
+    static const A_long kColMask  = (1 << kColShift) - 1;
+
+    std::vector<PIX> pix;
+    A_long tilesX = 0;
+
+    void build(const PF_EffectWorld* in) {
+        const A_long W=in->width, H=in->height;
+        tilesX = (W + kColMask) >> kColShift;
+        const A_long tilesY = (H + kTileRowMask) >> kTileRowShift;
+        pix.resize(static_cast<size_t>(tilesX)*tilesY << (kColShift + kTileRowShift));
+#if USE_OPENMP
+#pragma omp parallel for
+#endif
+        for (A_long y=0;y<H;++y){
+            const PIX* row = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(in->data) + y*in->rowbytes);
+            for (A_long x0=0;x0<W;x0+=kColMask+1){
+                const A_long n = std::min<A_long>(kColMask+1, W-x0);
+                std::copy(row+x0, row+x0+n, &pix[index(x0,y)]);
+            }
+        }
+    }
+
+    inline size_t index(A_long x, A_long y) const {
+        const size_t tile = static_cast<size_t>(y>>kTileRowShift)*tilesX + (size_t)(x>>kColShift);
+        return (tile << (kColShift + kTileRowShift)) + (size_t)(((y&kTileRowMask) << kColShift) | (x&kColMask));
+    }
+    inline const PIX* at(A_long x, A_long y) const { return &pix[index(x,y)]; }
+};
+
+// ---- Iteration scratch --------------------------------------------------------
+// Ping-pong target for Iterations > 1. Kept in the sequence data so playback
+// does not reallocate a full frame per render; sized in bytes so one buffer
+// serves every depth.
+struct PassScratch { std::vector<char> bytes; };
+
+void DeletePassScratch(void* p) { delete reinterpret_cast<PassScratch*>(p); }
+
 // ---- Core Kuwahara (shared for 8/16/32f) -----------------------------------
 template<typename PIX>
 static PF_Err KuwaharaCore(
     PF_InData*, PF_EffectWorld* input, PF_EffectWorld* output,
     A_long radius, A_long sectorCount, PF_FpLong anisotropy, PF_FpLong softness, PF_FpLong mix,
+    const KuwaharaRenderOptions& opts,
     KuwaharaSequenceData* seq,
-    void(*ComputeST)(const PF_EffectWorld*, void*),
+    float(*L)(const PF_EffectWorld*,A_long,A_long),
     float invMax)
 {
     PF_Err err = PF_Err_NONE;
@@ -185,14 +654,41 @@ static PF_Err KuwaharaCore(
         if (seq) seq->structure_tensor_data = tensor;
     }
 
+    // With the disk cache or prefetch on, key the tensor on input content so
+    // a changed frame is never served a stale field.
+    TensorPrefetcher* prefetch = seq ? reinterpret_cast<TensorPrefetcher*>(seq->tensor_prefetch) : nullptr;
+    const A_long tScale = TensorScale(opts.tensor_scale);
+    TensorCacheKey diskKey;
+    if (TensorDiskCache_Enabled() || prefetch) {
+        diskKey.content  = TensorDiskCache_HashWorld(input, sizeof(PIX));
+        diskKey.settings = TensorDiskCache_HashSettings(sizeof(PIX), kTensorBlurTaps, (std::uint32_t)tScale);
+    }
+
     const bool needCompute = (!seq || seq->needs_recompute ||
                               seq->cached_width  != input->width ||
                               seq->cached_height != input->height ||
                               seq->cached_radius != radius ||
-                              std::fabs(seq->cached_anisotropy - anisotropy) > 0.01);
+                              std::fabs(seq->cached_anisotropy - anisotropy) > 0.01 ||
+                              tensor->content_key != diskKey.content ||
+                              tensor->scale != tScale);
+    A_long tensorSource = KUWAHARA_TENSOR_SOURCE_REUSED;
     if (needCompute) {
-        tensor->init(input->width, input->height);
-        ComputeST(input, tensor);
+        TensorDiskMapping m;
+        if (prefetch && prefetch->take(diskKey, tensor)) {
+            // computed in the background from this frame's pixels
+            tensorSource = KUWAHARA_TENSOR_SOURCE_PREFETCH;
+        } else if (diskKey.content && TensorDiskCache_Map(diskKey, TensorDim(input->width, tScale), TensorDim(input->height, tScale), m)) {
+            tensor->adopt(m);
+            tensor->scale = tScale;
+            tensorSource = KUWAHARA_TENSOR_SOURCE_DISK;
+        } else {
+            ComputeST_Generic(input, tensor, L, tScale);
+            tensorSource = KUWAHARA_TENSOR_SOURCE_COMPUTED;
+            if (diskKey.content && TensorDiskCache_Enabled())
+                TensorDiskCache_Store(diskKey, tensor->w, tensor->h,
+                                      tensor->pe1, tensor->pe2, tensor->pvx, tensor->pvy);
+        }
+        tensor->content_key = diskKey.content;
         if (seq) {
             seq->cached_width = input->width; seq->cached_height = input->height;
             seq->cached_radius = radius; seq->cached_anisotropy = anisotropy;
@@ -200,122 +696,271 @@ static PF_Err KuwaharaCore(
         }
     }
 
+    // Area sampling: build the moment pyramid once, and lay out equal-area
+    // cells (kMipRings x kMipAngularTaps) per sector independent of radius.
+    MomentPyramid mips;
+    float ringR[kMipRings], ringDr[kMipRings];
+    if (opts.area_sampling) {
+        for (int i=0;i<kMipRings;++i){
+            const float r0 = (float)radius * std::sqrt((float)i       / (float)kMipRings);
+            const float r1 = (float)radius * std::sqrt((float)(i+1)   / (float)kMipRings);
+            ringR[i]  = (float)radius * std::sqrt(((float)i+0.5f) / (float)kMipRings);
+            ringDr[i] = r1 - r0;
+        }
+    }
+
     const A_long W=input->width, H=input->height;
-#if USE_OPENMP
-#pragma omp parallel for
-#endif
-    for (A_long y=0;y<H;++y){
-        const PIX* inRow  = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(input->data)  + y*input->rowbytes);
-        PIX*       outRow = reinterpret_cast<PIX*>      (reinterpret_cast<char*>      (output->data) + y*output->rowbytes);
-        for (A_long x=0;x<W;++x){
+    const A_long passes = std::max<A_long>(1, std::min<A_long>(opts.iterations, KUWAHARA_ITERATIONS_MAX));
+
+    // Tap budget: the smaller of the per-pixel and per-frame targets, spread
+    // evenly over sectors. The frame target covers all passes, so it is split
+    // over W*H*passes. Every sector keeps at least one tap, so budgets below
+    // sectorCount are raised to it (stats->scheduled_taps reports this).
+    const A_long rings = (radius>=1) ? (radius+1)/2 : 0;
+    const A_long tapsPerSector = opts.area_sampling ? (A_long)(kMipRings*kMipAngularTaps)
+                                                    : rings*kPointAngularTaps;
+    const A_long stencilTaps = tapsPerSector*sectorCount;
+    A_long budget = std::max<A_long>(0, opts.tap_budget);
+    bool   frameBound = false;   // a frame cap is hard: no rounding up to the full stencil
+    if (opts.frame_tap_budget > 0 && W > 0 && H > 0) {
+        const A_u_longlong perPixel = opts.frame_tap_budget / (static_cast<A_u_longlong>(W)*H*passes);
+        const A_long framePer = (A_long)std::max<A_u_longlong>(1, std::min<A_u_longlong>(perPixel, 0x7fffffff));
+        frameBound = budget<=0 || framePer<=budget;
+        budget = budget>0 ? std::min(budget, framePer) : framePer;
+    }
+    A_long keepPerSector = tapsPerSector;
+    if (budget>0 && budget<stencilTaps) keepPerSector = std::max<A_long>(1, budget/sectorCount);
+    if (!frameBound && keepPerSector*kBudgetFullDen >= tapsPerSector*kBudgetFullNum) keepPerSector = tapsPerSector;
+    const A_long mipStep   = CoprimeStep(kMipAngularTaps);
+    const A_long pointStep = CoprimeStep(kPointAngularTaps);
+
+    // Iterations: ping-pong between one scratch world and the output world so
+    // the last pass lands in output; every pass reuses the first pass's tensor.
+    PassScratch  localScratch;
+    PassScratch* scratchBuf = &localScratch;
+    if (seq && passes>1) {
+        if (!seq->pass_scratch) seq->pass_scratch = new PassScratch();
+        scratchBuf = reinterpret_cast<PassScratch*>(seq->pass_scratch);
+    } else if (seq && seq->pass_scratch) {
+        DeletePassScratch(seq->pass_scratch);   // single pass: give the frame back
+        seq->pass_scratch = nullptr;
+    }
+    PF_EffectWorld scratch = *output;
+    if (passes>1) {
+        scratchBuf->bytes.resize(static_cast<size_t>(W)*H*sizeof(PIX));
+        scratch.data = reinterpret_cast<decltype(scratch.data)>(scratchBuf->bytes.data());
+        scratch.rowbytes = W*(A_long)sizeof(PIX);
+    }
 
-            float e1=0,e2=0,vx=1,vy=0;
-            if (anisotropy>0.01) tensor->get(x,y,e1,e2,vx,vy);
-
-            // Build a simple anisotropic scaling aligned to eigenvector
-            float m00=1.f,m01=0.f,m10=0.f,m11=1.f;
-            if (anisotropy>0.01f){
-                float local = (e1 - e2) / (e1 + e2 + 1e-6f);
-                float eff = static_cast<float>(anisotropy) * local;
-                float alpha = 0.25f;
-                float sx = alpha/(eff+alpha);
-                float sy = (eff+alpha)/alpha;
-                m00 =  vx * sx; m01 = -vy * sy;
-                m10 =  vy * sx; m11 =  vx * sy;
+    // The tiled copy only serves point taps; area sampling reads the pyramid.
+    // Output is then walked in kBlockDim squares rather than full rows, so the
+    // source window in flight is a compact set of tiles instead of 2*radius
+    // full-width rows; without tiles each block is one row, as before.
+    const bool useTiles = opts.tiled_source && !opts.area_sampling;
+    TiledSource<PIX> tiles;
+    const A_long blockW  = useTiles ? kBlockDim : std::max<A_long>(1, W);
+    const A_long blockH  = useTiles ? kBlockDim : 1;
+    const A_long blocksX = (W + blockW - 1) / blockW;
+    const A_long blocksY = (H + blockH - 1) / blockH;
+
+    // Point stencil before the per-pixel anisotropic map: (r cos, r sin) per
+    // sector and tap, so the sector loop is left with the gather itself.
+    std::vector<float> stencil;
+    if (!opts.area_sampling) {
+        stencil.resize(static_cast<size_t>(sectorCount)*tapsPerSector*2);
+        const float half_ang = (float)M_PI / (float)sectorCount;
+        const float step_a   = 2.0f*half_ang / (float)(kPointAngularTaps-1);
+        for (A_long s=0;s<sectorCount;++s){
+            const float base = (float)s * 2.0f * (float)M_PI / (float)sectorCount;
+            for (A_long k=0;k<tapsPerSector;++k){
+                const float r = 1.f + 2.f*(float)(k / kPointAngularTaps);
+                const float a = -half_ang + (float)(k % kPointAngularTaps)*step_a;
+                float* st = &stencil[static_cast<size_t>(s*tapsPerSector + k)*2];
+                st[0] = r*std::cos(base+a);
+                st[1] = r*std::sin(base+a);
             }
+        }
+    }
 
-            struct Sector { double mR=0,mG=0,mB=0,sR2=0,sG2=0,sB2=0,c=0; } S[16];
-            float minVar=1e10f, maxVar=0.f; int best=-1;
-
-            const float half_ang = (float)M_PI / (float)sectorCount;
-            const float step_a   = half_ang / 2.0f; // ~5 angular taps/sector
-
-            for (int s=0;s<sectorCount;++s){
-                Sector& T = S[s];
-                const float base = (float)s * 2.0f * (float)M_PI / (float)sectorCount;
-
-                for (float r=1.f; r<= (float)radius; r+=2.f){
-                    for (float a=-half_ang; a<=half_ang+1e-6f; a+=step_a){
-                        float ca = std::cos(base+a), sa = std::sin(base+a);
-                        float sx = r*ca, sy=r*sa;
-                        float ox = m00*sx + m01*sy;
-                        float oy = m10*sx + m11*sy;
-                        A_long xx = x + (A_long)std::lround(ox);
-                        A_long yy = y + (A_long)std::lround(oy);
-                        if ((unsigned)xx >= (unsigned)W || (unsigned)yy >= (unsigned)H) continue;
-
-                        const PIX* p = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(input->data) + yy*input->rowbytes) + xx;
-                        float rV,gV,bV; fetchRGB(p, invMax, rV,gV,bV);
-                        T.mR += rV; T.mG += gV; T.mB += bV;
-                        T.sR2 += rV*rV; T.sG2 += gV*gV; T.sB2 += bV*bV; T.c += 1.0;
+    double taps = 0.0;
+    for (A_long pass=0; pass<passes; ++pass){
+        const bool toOutput = ((passes-pass)%2)==1;
+        const PF_EffectWorld* src = (pass==0) ? input : (toOutput ? &scratch : output);
+        PF_EffectWorld*       dst = toOutput ? output : &scratch;
+        const PF_FpLong passMix   = (pass==passes-1) ? mix : 1.0;
+        if (opts.area_sampling) mips.build<PIX>(src, invMax);
+        if (useTiles) tiles.build(src);
+
+#if USE_OPENMP
+#pragma omp parallel for reduction(+:taps)
+#endif
+        for (A_long b=0;b<blocksX*blocksY;++b){
+            const A_long bx0 = (b % blocksX)*blockW, by0 = (b / blocksX)*blockH;
+            const A_long bx1 = std::min(W, bx0+blockW), by1 = std::min(H, by0+blockH);
+            for (A_long y=by0;y<by1;++y){
+                const PIX* origRow = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(input->data) + y*input->rowbytes);
+                const PIX* inRow   = reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(src->data)   + y*src->rowbytes);
+                PIX*       outRow  = reinterpret_cast<PIX*>      (reinterpret_cast<char*>      (dst->data)   + y*dst->rowbytes);
+                for (A_long x=bx0;x<bx1;++x){
+
+                    float e1=0,e2=0,vx=1,vy=0;
+                    if (anisotropy>0.01) tensor->get(x,y,e1,e2,vx,vy);
+
+                    // Build a simple anisotropic scaling aligned to eigenvector
+                    float m00=1.f,m01=0.f,m10=0.f,m11=1.f;
+                    if (anisotropy>0.01f){
+                        float local = (e1 - e2) / (e1 + e2 + 1e-6f);
+                        float eff = static_cast<float>(anisotropy) * local;
+                        float alpha = 0.25f;
+                        float sx = alpha/(eff+alpha);
+                        float sy = (eff+alpha)/alpha;
+                        m00 =  vx * sx; m01 = -vy * sy;
+                        m10 =  vy * sx; m11 =  vx * sy;
+                    }
+
+                    struct Sector { double mR=0,mG=0,mB=0,sR2=0,sG2=0,sB2=0,c=0; } S[16];
+                    float minVar=1e10f, maxVar=0.f; int best=-1;
+
+                    const float half_ang = (float)M_PI / (float)sectorCount;
+                    const float noise    = InterleavedGradientNoise(x, y);
+                    const float noise2   = InterleavedGradientNoise(y, x);
+
+                    for (int s=0;s<sectorCount;++s){
+                        Sector& T = S[s];
+                        const float base = (float)s * 2.0f * (float)M_PI / (float)sectorCount;
+
+                        // Under a budget, evaluate keepPerSector distinct taps of the
+                        // tapsPerSector stencil (TapWalk), offset per pixel and sector so
+                        // the subset varies spatially (fine noise rather than banding).
+                        const A_long M = std::min(tapsPerSector, keepPerSector);
+                        const float  u = Fract(noise  + (float)s * kGoldenRatioConj);
+                        const float  v = Fract(noise2 + (float)s * kGoldenRatioConj);
+
+                        if (opts.area_sampling) {
+                            const float cellAng = 2.0f*half_ang / (float)kMipAngularTaps;
+                            float dxA[kMipAngularTaps], dyA[kMipAngularTaps], cellScale[kMipAngularTaps];
+                            for (int j=0;j<kMipAngularTaps;++j){
+                                const float ang = base - half_ang + ((float)j+0.5f)*cellAng;
+                                const float ca = std::cos(ang), sa = std::sin(ang);
+                                // Radial / tangential cell edges under the anisotropic map
+                                const float dx = m00*ca + m01*sa, dy = m10*ca + m11*sa;
+                                const float tx = m01*ca - m00*sa, ty = m11*ca - m10*sa;
+                                dxA[j]=dx; dyA[j]=dy;
+                                cellScale[j] = std::sqrt(dx*dx + dy*dy) * cellAng * std::sqrt(tx*tx + ty*ty);
+                            }
+                            TapWalk walk(std::max<A_long>(M,1), kMipRings, kMipAngularTaps, mipStep, u, v);
+                            for (A_long n=0;n<M;++n){
+                                int i, j;
+                                if (M==tapsPerSector) { j = (int)(n / kMipRings); i = (int)(n % kMipRings); }
+                                else { if (n) walk.next(); i = (int)walk.ring; j = (int)walk.angle; }
+                                const float r = ringR[i];
+                                const float px = (float)x + dxA[j]*r, py = (float)y + dyA[j]*r;
+                                if (px < -0.5f || py < -0.5f || px > (float)W-0.5f || py > (float)H-0.5f) continue;
+                                const float footprint = std::sqrt(ringDr[i] * r * cellScale[j]);
+                                float mo[6]; mips.sample(px, py, footprint, mo);
+                                T.mR += mo[0]; T.mG += mo[1]; T.mB += mo[2];
+                                T.sR2 += mo[3]; T.sG2 += mo[4]; T.sB2 += mo[5]; T.c += 1.0;
+                            }
+                        } else {
+                            // data()+offset, not &stencil[...]: radius < 1 leaves no rings and
+                            // an empty stencil, where indexing is undefined (M is 0 then too).
+                            const float* sectorStencil = stencil.data() + static_cast<size_t>(s*tapsPerSector)*2;
+                            TapWalk walk(std::max<A_long>(M,1), std::max<A_long>(rings,1), kPointAngularTaps, pointStep, u, v);
+                            for (A_long n=0;n<M;++n){
+                                A_long k = n;
+                                if (M!=tapsPerSector) { if (n) walk.next(); k = walk.ring*kPointAngularTaps + walk.angle; }
+                                const float sx = sectorStencil[2*k], sy = sectorStencil[2*k+1];
+                                float ox = m00*sx + m01*sy;
+                                float oy = m10*sx + m11*sy;
+                                A_long xx = x + (A_long)std::lround(ox);
+                                A_long yy = y + (A_long)std::lround(oy);
+                                if ((unsigned)xx >= (unsigned)W || (unsigned)yy >= (unsigned)H) continue;
+
+                                const PIX* p = useTiles ? tiles.at(xx, yy)
+                                                        : reinterpret_cast<const PIX*>(reinterpret_cast<const char*>(src->data) + yy*src->rowbytes) + xx;
+                                float rV,gV,bV; fetchRGB(p, invMax, rV,gV,bV);
+                                T.mR += rV; T.mG += gV; T.mB += bV;
+                                T.sR2 += rV*rV; T.sG2 += gV*gV; T.sB2 += bV*bV; T.c += 1.0;
+                            }
+                        }
+                        taps += T.c;
+                        if (T.c>0.0){
+                            double invC = 1.0/T.c;
+                            double mR=T.mR*invC, mG=T.mG*invC, mB=T.mB*invC;
+                            double vR=std::max(0.0, T.sR2*invC - mR*mR);
+                            double vG=std::max(0.0, T.sG2*invC - mG*mG);
+                            double vB=std::max(0.0, T.sB2*invC - mB*mB);
+                            float var = (float)(0.299*vR + 0.587*vG + 0.114*vB);
+                            if (var<minVar){ minVar=var; best=s; }
+                            if (var>maxVar){ maxVar=var; }
+                        }
                     }
-                }
-                if (T.c>0.0){
-                    double invC = 1.0/T.c;
-                    double mR=T.mR*invC, mG=T.mG*invC, mB=T.mB*invC;
-                    double vR=std::max(0.0, T.sR2*invC - mR*mR);
-                    double vG=std::max(0.0, T.sG2*invC - mG*mG);
-                    double vB=std::max(0.0, T.sB2*invC - mB*mB);
-                    float var = (float)(0.299*vR + 0.587*vG + 0.114*vB);
-                    if (var<minVar){ minVar=var; best=s; }
-                    if (var>maxVar){ maxVar=var; }
-                }
-            }
 
-            float fR=0,fG=0,fB=0,wSum=0;
-            float thr = minVar + (float)softness * (maxVar - minVar);
-            for (int s=0;s<sectorCount;++s){
-                const Sector& T = S[s];
-                if (T.c<=0.0) continue;
-                double invC = 1.0/T.c;
-                double mR=T.mR*invC, mG=T.mG*invC, mB=T.mB*invC;
-                double vR=std::max(0.0, T.sR2*invC - mR*mR);
-                double vG=std::max(0.0, T.sG2*invC - mG*mG);
-                double vB=std::max(0.0, T.sB2*invC - mB*mB);
-                float var = (float)(0.299*vR + 0.587*vG + 0.114*vB);
-                if (var<=thr){
-                    float w = 1.0f / (1.0f + (var - minVar));
-                    fR += (float)mR * w; fG += (float)mG * w; fB += (float)mB * w; wSum += w;
+                    float fR=0,fG=0,fB=0,wSum=0;
+                    float thr = minVar + (float)softness * (maxVar - minVar);
+                    for (int s=0;s<sectorCount;++s){
+                        const Sector& T = S[s];
+                        if (T.c<=0.0) continue;
+                        double invC = 1.0/T.c;
+                        double mR=T.mR*invC, mG=T.mG*invC, mB=T.mB*invC;
+                        double vR=std::max(0.0, T.sR2*invC - mR*mR);
+                        double vG=std::max(0.0, T.sG2*invC - mG*mG);
+                        double vB=std::max(0.0, T.sB2*invC - mB*mB);
+                        float var = (float)(0.299*vR + 0.587*vG + 0.114*vB);
+                        if (var<=thr){
+                            float w = 1.0f / (1.0f + (var - minVar));
+                            fR += (float)mR * w; fG += (float)mG * w; fB += (float)mB * w; wSum += w;
+                        }
+                    }
+                    if (wSum>0){ fR/=wSum; fG/=wSum; fB/=wSum; }
+                    else if (best>=0){
+                        const Sector& T = S[best]; double invC=1.0/T.c;
+                        fR=(float)(T.mR*invC); fG=(float)(T.mG*invC); fB=(float)(T.mB*invC);
+                    } else { outRow[x]=inRow[x]; continue; }
+
+                    // Mix with original
+                    float oR,oG,oB; fetchRGB(&origRow[x], invMax, oR,oG,oB);
+                    fR = fR * (float)passMix + oR * (1.f - (float)passMix);
+                    fG = fG * (float)passMix + oG * (1.f - (float)passMix);
+                    fB = fB * (float)passMix + oB * (1.f - (float)passMix);
+
+                    storeRGB(&outRow[x], fR,fG,fB);
+                    outRow[x].alpha = origRow[x].alpha;
                 }
             }
-            if (wSum>0){ fR/=wSum; fG/=wSum; fB/=wSum; }
-            else if (best>=0){
-                const Sector& T = S[best]; double invC=1.0/T.c;
-                fR=(float)(T.mR*invC); fG=(float)(T.mG*invC); fB=(float)(T.mB*invC);
-            } else { outRow[x]=inRow[x]; continue; }
-
-            // Mix with original
-            float oR,oG,oB; fetchRGB(&inRow[x], invMax, oR,oG,oB);
-            fR = fR * (float)mix + oR * (1.f - (float)mix);
-            fG = fG * (float)mix + oG * (1.f - (float)mix);
-            fB = fB * (float)mix + oB * (1.f - (float)mix);
-
-            storeRGB(&outRow[x], fR,fG,fB);
-            outRow[x].alpha = inRow[x].alpha;
         }
     }
+
+    if (opts.stats) {
+        const double px = (double)W * (double)H;
+        opts.stats->stencil_taps        = stencilTaps;
+        opts.stats->scheduled_taps      = std::min(tapsPerSector, keepPerSector)*sectorCount;
+        opts.stats->total_taps          = (A_u_longlong)taps;
+        opts.stats->mean_taps_per_pixel = px>0.0 ? taps/(px*(double)passes) : 0.0;
+        opts.stats->tensor_source       = tensorSource;
+    }
     return err;
 }
 
 // ---- Smart wrappers ----------------------------------------------------------
-PF_Err ProcessKuwaharaWorld8Smart (PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, void* q){
-    return KuwaharaCore<PF_Pixel8>(in, i, o, r, s, a, so, m, reinterpret_cast<KuwaharaSequenceData*>(q), &ComputeStructureTensorField8, 1.0f/255.0f);
+PF_Err ProcessKuwaharaWorld8Smart (PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt, void* q){
+    return KuwaharaCore<PF_Pixel8>(in, i, o, r, s, a, so, m, opt ? *opt : KuwaharaRenderOptions(), reinterpret_cast<KuwaharaSequenceData*>(q), &Luma8, 1.0f/255.0f);
 }
-PF_Err ProcessKuwaharaWorld16Smart(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, void* q){
-    return KuwaharaCore<PF_Pixel16>(in, i, o, r, s, a, so, m, reinterpret_cast<KuwaharaSequenceData*>(q), &ComputeStructureTensorField16, 1.0f/32768.0f);
+PF_Err ProcessKuwaharaWorld16Smart(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt, void* q){
+    return KuwaharaCore<PF_Pixel16>(in, i, o, r, s, a, so, m, opt ? *opt : KuwaharaRenderOptions(), reinterpret_cast<KuwaharaSequenceData*>(q), &Luma16, 1.0f/32768.0f);
 }
-PF_Err ProcessKuwaharaWorld32fSmart(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, void* q){
-    return KuwaharaCore<PF_PixelFloat>(in, i, o, r, s, a, so, m, reinterpret_cast<KuwaharaSequenceData*>(q), &ComputeStructureTensorField32f, 1.0f);
+PF_Err ProcessKuwaharaWorld32fSmart(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt, void* q){
+    return KuwaharaCore<PF_PixelFloat>(in, i, o, r, s, a, so, m, opt ? *opt : KuwaharaRenderOptions(), reinterpret_cast<KuwaharaSequenceData*>(q), &Luma32f, 1.0f);
 }
 
 // ---- Legacy wrappers ---------------------------------------------------------
-PF_Err ProcessKuwaharaWorld8 (PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m){
-    return ProcessKuwaharaWorld8Smart (in, i, o, r, s, a, so, m, nullptr);
+PF_Err ProcessKuwaharaWorld8 (PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt){
+    return ProcessKuwaharaWorld8Smart (in, i, o, r, s, a, so, m, opt, nullptr);
 }
-PF_Err ProcessKuwaharaWorld16(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m){
-    return ProcessKuwaharaWorld16Smart(in, i, o, r, s, a, so, m, nullptr);
+PF_Err ProcessKuwaharaWorld16(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt){
+    return ProcessKuwaharaWorld16Smart(in, i, o, r, s, a, so, m, opt, nullptr);
 }
-PF_Err ProcessKuwaharaWorld32f(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m){
-    return ProcessKuwaharaWorld32fSmart(in, i, o, r, s, a, so, m, nullptr);
+PF_Err ProcessKuwaharaWorld32f(PF_InData* in, PF_EffectWorld* i, PF_EffectWorld* o, A_long r, A_long s, PF_FpLong a, PF_FpLong so, PF_FpLong m, const KuwaharaRenderOptions* opt){
+    return ProcessKuwaharaWorld32fSmart(in, i, o, r, s, a, so, m, opt, nullptr);
 }
 
@@ -0,0 +1,332 @@
+/*******************************************************************/
+/* Kuwahara Core — persistent structure-tensor cache               */
+/*******************************************************************/
+#include "TensorDiskCache.h"
+#include "API.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(AE_OS_WIN)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <Windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// ---- Configuration ----------------------------------------------------------
+// The directory is only scanned on configure, every kRescanInterval stores
+// (other processes may share it), and when the running total crosses the cap;
+// eviction then goes down to kEvictLowWater of the cap so the next few stores
+// don't scan again.
+static const unsigned kRescanInterval = 64;
+static const double   kEvictLowWater  = 0.9;
+static const auto     kStaleTempAge   = std::chrono::minutes(10);   // abandoned *.skt.tmp*
+
+static std::mutex    g_cacheMutex;        // guards everything below
+static fs::path      g_cacheDir;
+static std::uint64_t g_cacheMaxBytes = 0;
+static std::uint64_t g_cacheBytes    = 0;   // running total of .skt files
+static unsigned      g_storesSinceScan = 0;
+static std::atomic<bool> g_cacheEnabled{false};
+
+static void ScanAndEvict(const fs::path& dir, std::uint64_t cap);
+
+void ConfigureTensorDiskCache(const char* directory, A_u_longlong max_bytes) {
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    g_cacheEnabled = false;
+    g_cacheDir.clear();
+    g_cacheMaxBytes = max_bytes;
+    g_cacheBytes = 0;
+    if (!directory || !*directory || max_bytes == 0) return;
+
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec || !fs::is_directory(directory, ec)) return;
+    g_cacheDir = directory;
+    ScanAndEvict(g_cacheDir, g_cacheMaxBytes);
+    g_cacheEnabled = true;
+}
+
+bool TensorDiskCache_Enabled() { return g_cacheEnabled.load(std::memory_order_relaxed); }
+
+// ---- Hashing ----------------------------------------------------------------
+// FNV-1a over 64-bit words, each word first run through murmur's fmix64: a
+// multiply only carries upward, so without the mix a change confined to a
+// word's high bytes would never reach the low bits of the hash. The byte
+// tail is folded in one at a time.
+static const std::uint64_t kFnvOffset = 1469598103934665603ull;
+static const std::uint64_t kFnvPrime  = 1099511628211ull;
+
+static inline std::uint64_t Fmix64(std::uint64_t k) {
+    k ^= k >> 33; k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33; k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static inline std::uint64_t HashBytes(std::uint64_t h, const void* data, std::size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t v; std::memcpy(&v, p + i, 8);
+        h = (h ^ Fmix64(v)) * kFnvPrime;
+    }
+    for (; i < n; ++i) h = (h ^ p[i]) * kFnvPrime;
+    return h;
+}
+
+// HashBytes over a stream delivered in pieces: a partial word at the end of one
+// piece is completed by the next, so the result depends only on the bytes and
+// not on where the caller split them (the writer hashes four planes, the
+// reader one mapped payload).
+struct StreamHash {
+    std::uint64_t h = kFnvOffset;
+    unsigned char pending[8];
+    std::size_t   npending = 0;
+
+    void update(const void* data, std::size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        if (npending) {
+            const std::size_t take = std::min<std::size_t>(n, 8 - npending);
+            std::memcpy(pending + npending, p, take);
+            npending += take; p += take; n -= take;
+            if (npending < 8) return;
+            h = HashBytes(h, pending, 8);
+            npending = 0;
+        }
+        const std::size_t whole = n & ~static_cast<std::size_t>(7);
+        h = HashBytes(h, p, whole);
+        std::memcpy(pending, p + whole, n - whole);
+        npending = n - whole;
+    }
+    std::uint64_t finish() const { return HashBytes(h, pending, npending); }
+};
+
+std::uint64_t TensorDiskCache_HashWorld(const PF_EffectWorld* world, std::size_t pixelBytes) {
+    std::uint64_t h = kFnvOffset;
+    const std::size_t rowBytes = static_cast<std::size_t>(world->width) * pixelBytes;
+    for (A_long y = 0; y < world->height; ++y) {
+        const char* row = reinterpret_cast<const char*>(world->data) + static_cast<std::ptrdiff_t>(y) * world->rowbytes;
+        h = HashBytes(h, row, rowBytes);
+    }
+    const std::int32_t dims[2] = { world->width, world->height };
+    return Fmix64(HashBytes(h, dims, sizeof(dims)));
+}
+
+std::uint64_t TensorDiskCache_HashSettings(std::uint32_t pixelBytes, std::uint32_t blurTaps, std::uint32_t tensorScale) {
+    const std::uint32_t s[4] = { KUWAHARA_TENSOR_CACHE_VERSION, pixelBytes, blurTaps, tensorScale };
+    return HashBytes(kFnvOffset, s, sizeof(s));
+}
+
+// ---- Paths ------------------------------------------------------------------
+static fs::path CachePath(const fs::path& dir, const TensorCacheKey& key) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "%016llx-%016llx.skt",
+                  (unsigned long long)key.content, (unsigned long long)key.settings);
+    return dir / name;
+}
+
+static fs::path CacheDir() {
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    return g_cacheDir;
+}
+
+// ---- Platform mapping -------------------------------------------------------
+static bool MapReadOnly(const fs::path& path, void*& base, std::size_t& bytes) {
+#if defined(AE_OS_WIN)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) { CloseHandle(file); return false; }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+    base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!base) return false;
+    bytes = static_cast<std::size_t>(size.QuadPart);
+    return true;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) { ::close(fd); return false; }
+    void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    base = p;
+    bytes = static_cast<std::size_t>(st.st_size);
+    return true;
+#endif
+}
+
+void TensorDiskCache_Unmap(TensorDiskMapping& m) {
+    if (m.base) {
+#if defined(AE_OS_WIN)
+        UnmapViewOfFile(m.base);
+#else
+        ::munmap(m.base, m.bytes);
+#endif
+    }
+    m = TensorDiskMapping();
+}
+
+// ---- Lookup -----------------------------------------------------------------
+static std::uint64_t PayloadChecksum(const void* payload, std::size_t bytes) {
+    StreamHash s;
+    s.update(payload, bytes);
+    return s.finish();
+}
+
+bool TensorDiskCache_Map(const TensorCacheKey& key, A_long w, A_long h, TensorDiskMapping& out) {
+    if (!TensorDiskCache_Enabled()) return false;
+    const fs::path dir = CacheDir();
+    if (dir.empty()) return false;
+    const fs::path path = CachePath(dir, key);
+
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return false;
+
+    void* base = nullptr; std::size_t bytes = 0;
+    if (!MapReadOnly(path, base, bytes)) return false;
+
+    TensorDiskMapping m;
+    m.base = base; m.bytes = bytes; m.w = w; m.h = h;
+
+    const std::uint64_t N = static_cast<std::uint64_t>(w) * static_cast<std::uint64_t>(h);
+    const std::uint64_t payload = N * 4u * sizeof(float);
+    const TensorCacheHeader* hdr = static_cast<const TensorCacheHeader*>(base);
+    const bool valid =
+        bytes >= sizeof(TensorCacheHeader) &&
+        hdr->magic == KUWAHARA_TENSOR_CACHE_MAGIC &&
+        hdr->version == KUWAHARA_TENSOR_CACHE_VERSION &&
+        hdr->header_bytes == sizeof(TensorCacheHeader) &&
+        hdr->width == w && hdr->height == h && hdr->plane_count == 4u &&
+        hdr->content_hash == key.content && hdr->settings_hash == key.settings &&
+        hdr->payload_bytes == payload &&
+        bytes == sizeof(TensorCacheHeader) + payload &&
+        PayloadChecksum(static_cast<const char*>(base) + sizeof(TensorCacheHeader),
+                        static_cast<std::size_t>(payload)) == hdr->payload_checksum;
+
+    if (!valid) {
+        TensorDiskCache_Unmap(m);
+        if (fs::remove(path, ec)) {
+            std::lock_guard<std::mutex> lock(g_cacheMutex);
+            g_cacheBytes -= std::min<std::uint64_t>(g_cacheBytes, bytes);
+        }
+        return false;
+    }
+
+    const float* planes = reinterpret_cast<const float*>(static_cast<const char*>(base) + sizeof(TensorCacheHeader));
+    m.e1 = planes; m.e2 = planes + N; m.vx = planes + 2*N; m.vy = planes + 3*N;
+    out = m;
+
+    // Touch for LRU eviction.
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+// ---- Store / evict ----------------------------------------------------------
+// Recounts the directory, removes temp files abandoned by interrupted writes,
+// and evicts least recently used entries if over the cap. Caller holds the lock.
+static void ScanAndEvict(const fs::path& dir, std::uint64_t cap) {
+    struct Entry { fs::path path; fs::file_time_type t; std::uint64_t bytes; };
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+    const fs::file_time_type staleBefore = fs::file_time_type::clock::now() - kStaleTempAge;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code fe;
+        if (it->path().extension() != ".skt") {
+            if (it->path().filename().string().find(".skt.tmp") != std::string::npos &&
+                it->last_write_time(fe) < staleBefore && !fe)
+                fs::remove(it->path(), fe);
+            continue;
+        }
+        const std::uint64_t sz = it->file_size(fe);
+        if (fe) continue;
+        entries.push_back({ it->path(), it->last_write_time(fe), sz });
+        total += sz;
+    }
+    g_storesSinceScan = 0;
+    g_cacheBytes = total;
+    if (total <= cap) return;
+
+    const std::uint64_t target = static_cast<std::uint64_t>(static_cast<double>(cap) * kEvictLowWater);
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){ return a.t < b.t; });
+    for (const Entry& e : entries) {
+        if (total <= target) break;
+        std::error_code re;
+        if (fs::remove(e.path, re)) total -= e.bytes;
+    }
+    g_cacheBytes = total;
+}
+
+void TensorDiskCache_Store(const TensorCacheKey& key, A_long w, A_long h,
+                           const float* e1, const float* e2, const float* vx, const float* vy) {
+    if (!TensorDiskCache_Enabled()) return;
+    const fs::path dir = CacheDir();
+    if (dir.empty()) return;
+
+    const std::size_t N = static_cast<std::size_t>(w) * static_cast<std::size_t>(h);
+    const std::size_t planeBytes = N * sizeof(float);
+
+    TensorCacheHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = KUWAHARA_TENSOR_CACHE_MAGIC;
+    hdr.version = KUWAHARA_TENSOR_CACHE_VERSION;
+    hdr.header_bytes = sizeof(TensorCacheHeader);
+    hdr.width = w; hdr.height = h; hdr.plane_count = 4u;
+    hdr.content_hash = key.content; hdr.settings_hash = key.settings;
+    hdr.payload_bytes = static_cast<std::uint64_t>(planeBytes) * 4u;
+    StreamHash sum;   // one stream, as Map sees it
+    const float* planes[4] = { e1, e2, vx, vy };
+    for (const float* p : planes) sum.update(p, planeBytes);
+    hdr.payload_checksum = sum.finish();
+
+    // Write under a unique temp name, then rename so readers never see a partial file.
+    static std::atomic<unsigned> s_serial{0};
+    const fs::path finalPath = CachePath(dir, key);
+    fs::path tmpPath = finalPath;
+    tmpPath += ".tmp" + std::to_string(
+        static_cast<unsigned long long>(std::chrono::steady_clock::now().time_since_epoch().count())) +
+        "-" + std::to_string(s_serial.fetch_add(1));
+
+    bool ok = false;
+#if defined(AE_OS_WIN)
+    FILE* fp = _wfopen(tmpPath.c_str(), L"wb");
+#else
+    FILE* fp = std::fopen(tmpPath.c_str(), "wb");
+#endif
+    if (fp) {
+        ok = std::fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+        for (const float* p : planes) ok = ok && std::fwrite(p, 1, planeBytes, fp) == planeBytes;
+        ok = (std::fclose(fp) == 0) && ok;
+    }
+    std::error_code ec;
+    const bool replaced = fs::exists(finalPath, ec);
+    if (ok) fs::rename(tmpPath, finalPath, ec);
+    if (!ok || ec) { fs::remove(tmpPath, ec); return; }
+
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+    if (!replaced) g_cacheBytes += sizeof(hdr) + hdr.payload_bytes;
+    if (++g_storesSinceScan >= kRescanInterval || g_cacheBytes > g_cacheMaxBytes)
+        ScanAndEvict(dir, g_cacheMaxBytes);
+}
@@ -0,0 +1,66 @@
+/*******************************************************************/
+/* Kuwahara Core — persistent structure-tensor cache (internal)    */
+/*******************************************************************/
+#pragma once
+#ifndef KUWAHARA_TENSOR_DISK_CACHE_H
+#define KUWAHARA_TENSOR_DISK_CACHE_H
+
+#include "AE_Effect.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// ---- On-disk format (version 3) ---------------------------------------------
+// <dir>/<content:016x>-<settings:016x>.skt
+//   TensorCacheHeader (64 bytes, host byte order)
+//   float e1[w*h], e2[w*h], vx[w*h], vy[w*h]
+// The planes are mapped read-only and handed to StructureTensorField as-is.
+// w/h are the field's dimensions, i.e. the input size divided by the tensor
+// scale (which is part of the settings hash).
+#define KUWAHARA_TENSOR_CACHE_MAGIC   0x43544B53u   // 'SKTC'
+#define KUWAHARA_TENSOR_CACHE_VERSION 3u
+
+struct TensorCacheHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t header_bytes;
+    std::int32_t  width;
+    std::int32_t  height;
+    std::uint32_t plane_count;
+    std::uint64_t content_hash;
+    std::uint64_t settings_hash;
+    std::uint64_t payload_bytes;
+    std::uint64_t payload_checksum;
+    std::uint64_t reserved;
+};
+static_assert(sizeof(TensorCacheHeader) == 64, "tensor cache header must stay 64 bytes");
+
+struct TensorCacheKey {
+    std::uint64_t content  = 0;   // hash of the input pixels
+    std::uint64_t settings = 0;   // hash of everything else the tensor depends on
+};
+
+// A read-only view of a cached tensor. Owns the mapping until released.
+struct TensorDiskMapping {
+    const float* e1 = nullptr;
+    const float* e2 = nullptr;
+    const float* vx = nullptr;
+    const float* vy = nullptr;
+    A_long       w  = 0, h = 0;
+    void*        base  = nullptr;
+    std::size_t  bytes = 0;
+};
+
+bool          TensorDiskCache_Enabled();
+std::uint64_t TensorDiskCache_HashWorld(const PF_EffectWorld* world, std::size_t pixelBytes);
+std::uint64_t TensorDiskCache_HashSettings(std::uint32_t pixelBytes, std::uint32_t blurTaps, std::uint32_t tensorScale);
+
+// Maps a cached tensor. Returns false on miss; corrupt files are removed.
+bool TensorDiskCache_Map(const TensorCacheKey& key, A_long w, A_long h, TensorDiskMapping& out);
+void TensorDiskCache_Unmap(TensorDiskMapping& m);
+
+// Writes a tensor atomically, then evicts least recently used files over the cap.
+void TensorDiskCache_Store(const TensorCacheKey& key, A_long w, A_long h,
+                           const float* e1, const float* e2, const float* vx, const float* vy);
+
+#endif